@@ -0,0 +1,150 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+// Axis-aligned box. Empty until a point is added.
+struct BoundingBox
+{
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    void add(const glm::vec3& point);
+
+    bool is_empty() const;
+    glm::vec3 center() const;
+
+    // Smallest axis-aligned box holding this box transformed by `matrix`.
+    BoundingBox transformed(const glm::mat4& matrix) const;
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // Sphere holding this sphere transformed by `matrix`, which may scale
+    // unevenly.
+    BoundingSphere transformed(const glm::mat4& matrix) const;
+};
+
+/*
+ * The six clip planes of a view-projection matrix, facing inwards. Tests are
+ * conservative: a volume is only rejected when it lies wholly outside one
+ * plane, so some volumes near the corners are kept although nothing of them
+ * is visible.
+ */
+class Frustum
+{
+public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& view_projection);
+
+    bool intersects(const BoundingSphere& sphere) const;
+    bool intersects(const BoundingBox& box) const;
+private:
+    // xyz is the normal and w the distance, so a point p is inside a plane
+    // when dot(xyz, p) + w >= 0.
+    std::array<glm::vec4, 6> planes{};
+};
+
+void BoundingBox::add(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+bool BoundingBox::is_empty() const
+{
+    return min.x > max.x;
+}
+
+glm::vec3 BoundingBox::center() const
+{
+    return (min + max) * 0.5f;
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4& matrix) const
+{
+    if (is_empty())
+        return *this;
+
+    // Each output axis spans the sum of each input axis's smallest and
+    // largest contribution to it (Arvo's method), without transforming all
+    // eight corners.
+    BoundingBox result;
+    result.min = glm::vec3(matrix[3]);
+    result.max = glm::vec3(matrix[3]);
+
+    for (int column = 0; column < 3; column++)
+    {
+        glm::vec3 a = glm::vec3(matrix[column]) * min[column];
+        glm::vec3 b = glm::vec3(matrix[column]) * max[column];
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+
+    return result;
+}
+
+BoundingSphere BoundingSphere::transformed(const glm::mat4& matrix) const
+{
+    float scale = std::max({glm::length(glm::vec3(matrix[0])),
+        glm::length(glm::vec3(matrix[1])),
+        glm::length(glm::vec3(matrix[2]))});
+
+    return {glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * scale};
+}
+
+Frustum::Frustum(const glm::mat4& view_projection)
+{
+    // Gribb and Hartmann: each plane is the fourth row of the matrix plus or
+    // minus one of the others. glm is column-major, so gather the rows.
+    glm::mat4 rows = glm::transpose(view_projection);
+
+    planes[0] = rows[3] + rows[0];  // Left.
+    planes[1] = rows[3] - rows[0];  // Right.
+    planes[2] = rows[3] + rows[1];  // Bottom.
+    planes[3] = rows[3] - rows[1];  // Top.
+    planes[4] = rows[3] + rows[2];  // Near.
+    planes[5] = rows[3] - rows[2];  // Far.
+
+    // Normalize, so sphere tests can compare distances with the radius.
+    for (auto& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const
+{
+    for (const auto& plane : planes)
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+            return false;
+
+    return true;
+}
+
+bool Frustum::intersects(const BoundingBox& box) const
+{
+    if (box.is_empty())
+        return false;
+
+    for (const auto& plane : planes)
+    {
+        // The corner furthest along the plane's normal.
+        glm::vec3 corner(
+            plane.x >= 0.0f ? box.max.x : box.min.x,
+            plane.y >= 0.0f ? box.max.y : box.min.y,
+            plane.z >= 0.0f ? box.max.z : box.min.z);
+
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            return false;
+    }
+
+    return true;
+}
+
+#endif /* BOUNDS_HPP */
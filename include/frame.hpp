@@ -0,0 +1,19 @@
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include <glm/glm.hpp>
+
+// std140 mirror of the "Frame" uniform block in src/common/frame.glsl: the
+// camera and light matrices every program reads, written once per frame.
+struct FrameStd140
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 light_space_matrix;
+    glm::vec3 view_pos;
+    float pad0;
+};
+
+static_assert(sizeof(FrameStd140) == 208, "std140 Frame size");
+
+#endif /* FRAME_HPP */
@@ -0,0 +1,282 @@
+#ifndef GL_EXTENSIONS_HPP
+#define GL_EXTENSIONS_HPP
+
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include "gl_state.hpp"
+
+/*
+ * glad was generated for the GL 3.3 core profile without extensions. Entry
+ * points from newer versions are declared here, loaded at runtime by
+ * load_gl_extensions() and only used when the context reports support.
+ */
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM1IPROC)(GLuint program, GLint location, GLint v0);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM1FPROC)(GLuint program, GLint location, GLfloat v0);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM3FPROC)(GLuint program, GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORMMATRIX4FVPROC)(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+typedef void (APIENTRYP PFNGLSHADERBINARYPROC)(GLsizei count, const GLuint* shaders, GLenum binaryformat, const void* binary, GLsizei length);
+#endif
+
+#ifndef GL_VERSION_4_0
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_VERSION_4_3
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+#endif
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+#endif
+
+#ifndef GL_VERSION_4_6
+#define GL_SHADER_BINARY_FORMAT_SPIR_V 0x9551
+typedef void (APIENTRYP PFNGLSPECIALIZESHADERPROC)(GLuint shader, const GLchar* pEntryPoint, GLuint numSpecializationConstants, const GLuint* pConstantIndex, const GLuint* pConstantValue);
+#endif
+
+#ifndef GL_VERSION_4_5
+typedef void (APIENTRYP PFNGLNAMEDBUFFERDATAPROC)(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage);
+typedef void (APIENTRYP PFNGLNAMEDBUFFERSUBDATAPROC)(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+typedef void (APIENTRYP PFNGLCREATETEXTURESPROC)(GLenum target, GLsizei n, GLuint* textures);
+typedef void (APIENTRYP PFNGLTEXTURESTORAGE2DPROC)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXTURESUBIMAGE2DPROC)(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
+typedef void (APIENTRYP PFNGLTEXTUREPARAMETERIPROC)(GLuint texture, GLenum pname, GLint param);
+typedef void (APIENTRYP PFNGLGENERATETEXTUREMIPMAPPROC)(GLuint texture);
+#endif
+
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+#endif
+
+struct GLExtensions
+{
+    // GL 4.1 or ARB_get_program_binary, with at least one binary format.
+    bool has_program_binary = false;
+    PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+    PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+    PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+    // KHR_parallel_shader_compile or its ARB twin. Compiles and links run on
+    // driver threads and GL_COMPLETION_STATUS_KHR can be polled.
+    bool has_parallel_shader_compile = false;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreadsKHR = nullptr;
+
+    // GL 4.1 or ARB_separate_shader_objects. Uniforms can be set on any
+    // program without making it current.
+    bool has_program_uniform = false;
+    PFNGLPROGRAMUNIFORM1IPROC ProgramUniform1i = nullptr;
+    PFNGLPROGRAMUNIFORM1FPROC ProgramUniform1f = nullptr;
+    PFNGLPROGRAMUNIFORM3FPROC ProgramUniform3f = nullptr;
+    PFNGLPROGRAMUNIFORMMATRIX4FVPROC ProgramUniformMatrix4fv = nullptr;
+
+    // GL 4.5 or ARB_direct_state_access. Buffers and textures can be edited
+    // without binding them.
+    bool has_direct_state_access = false;
+    PFNGLNAMEDBUFFERDATAPROC NamedBufferData = nullptr;
+    PFNGLNAMEDBUFFERSUBDATAPROC NamedBufferSubData = nullptr;
+    PFNGLCREATETEXTURESPROC CreateTextures = nullptr;
+    PFNGLTEXTURESTORAGE2DPROC TextureStorage2D = nullptr;
+    PFNGLTEXTURESUBIMAGE2DPROC TextureSubImage2D = nullptr;
+    PFNGLTEXTUREPARAMETERIPROC TextureParameteri = nullptr;
+    PFNGLGENERATETEXTUREMIPMAPPROC GenerateTextureMipmap = nullptr;
+
+    // GL 4.3 or ARB_multi_draw_indirect. Draw commands can be read from a
+    // buffer bound to GL_DRAW_INDIRECT_BUFFER.
+    bool has_multi_draw_indirect = false;
+    PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+
+    // GL 4.4 or ARB_buffer_storage. Buffers can stay mapped while the GPU
+    // reads them.
+    bool has_buffer_storage = false;
+    PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+    // GL 4.6 or ARB_gl_spirv. Shaders can be loaded from SPIR-V modules.
+    bool has_gl_spirv = false;
+    PFNGLSHADERBINARYPROC ShaderBinary = nullptr;
+    PFNGLSPECIALIZESHADERPROC SpecializeShader = nullptr;
+};
+
+GLExtensions gl_ext;
+
+bool gl_version_at_least(int major, int minor)
+{
+    return GLVersion.major > major ||
+        (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+bool has_gl_extension(const char* name)
+{
+    int num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+
+    for (int i = 0; i < num_extensions; i++)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+// Call once after gladLoadGLLoader() with the same loader.
+void load_gl_extensions(GLADloadproc load)
+{
+    gl_ext = GLExtensions{};
+
+    // Program binaries.
+    if (gl_version_at_least(4, 1) || has_gl_extension("GL_ARB_get_program_binary"))
+    {
+        gl_ext.GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+        gl_ext.ProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+        gl_ext.ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+
+        int num_formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+        gl_ext.has_program_binary = gl_ext.GetProgramBinary &&
+            gl_ext.ProgramBinary &&
+            gl_ext.ProgramParameteri &&
+            num_formats > 0;
+    }
+
+    // Parallel shader compilation.
+    if (has_gl_extension("GL_KHR_parallel_shader_compile"))
+    {
+        gl_ext.MaxShaderCompilerThreadsKHR =
+            (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+    }
+    else if (has_gl_extension("GL_ARB_parallel_shader_compile"))
+    {
+        gl_ext.MaxShaderCompilerThreadsKHR =
+            (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+    }
+
+    if (gl_ext.MaxShaderCompilerThreadsKHR)
+    {
+        // Let the driver pick the number of compiler threads.
+        gl_ext.MaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        gl_ext.has_parallel_shader_compile = true;
+    }
+
+    // Program uniforms.
+    if (gl_version_at_least(4, 1) || has_gl_extension("GL_ARB_separate_shader_objects"))
+    {
+        gl_ext.ProgramUniform1i = (PFNGLPROGRAMUNIFORM1IPROC)load("glProgramUniform1i");
+        gl_ext.ProgramUniform1f = (PFNGLPROGRAMUNIFORM1FPROC)load("glProgramUniform1f");
+        gl_ext.ProgramUniform3f = (PFNGLPROGRAMUNIFORM3FPROC)load("glProgramUniform3f");
+        gl_ext.ProgramUniformMatrix4fv = (PFNGLPROGRAMUNIFORMMATRIX4FVPROC)load("glProgramUniformMatrix4fv");
+
+        gl_ext.has_program_uniform = gl_ext.ProgramUniform1i &&
+            gl_ext.ProgramUniform1f &&
+            gl_ext.ProgramUniform3f &&
+            gl_ext.ProgramUniformMatrix4fv;
+    }
+
+    // Direct state access.
+    if (gl_version_at_least(4, 5) || has_gl_extension("GL_ARB_direct_state_access"))
+    {
+        gl_ext.NamedBufferData = (PFNGLNAMEDBUFFERDATAPROC)load("glNamedBufferData");
+        gl_ext.NamedBufferSubData = (PFNGLNAMEDBUFFERSUBDATAPROC)load("glNamedBufferSubData");
+        gl_ext.CreateTextures = (PFNGLCREATETEXTURESPROC)load("glCreateTextures");
+        gl_ext.TextureStorage2D = (PFNGLTEXTURESTORAGE2DPROC)load("glTextureStorage2D");
+        gl_ext.TextureSubImage2D = (PFNGLTEXTURESUBIMAGE2DPROC)load("glTextureSubImage2D");
+        gl_ext.TextureParameteri = (PFNGLTEXTUREPARAMETERIPROC)load("glTextureParameteri");
+        gl_ext.GenerateTextureMipmap = (PFNGLGENERATETEXTUREMIPMAPPROC)load("glGenerateTextureMipmap");
+
+        gl_ext.has_direct_state_access = gl_ext.NamedBufferData &&
+            gl_ext.NamedBufferSubData &&
+            gl_ext.CreateTextures &&
+            gl_ext.TextureStorage2D &&
+            gl_ext.TextureSubImage2D &&
+            gl_ext.TextureParameteri &&
+            gl_ext.GenerateTextureMipmap;
+    }
+
+    // Multi-draw indirect. The extension builds on ARB_draw_indirect.
+    if (gl_version_at_least(4, 3) ||
+        (has_gl_extension("GL_ARB_multi_draw_indirect") &&
+            (gl_version_at_least(4, 0) || has_gl_extension("GL_ARB_draw_indirect"))))
+    {
+        gl_ext.MultiDrawElementsIndirect =
+            (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+        gl_ext.has_multi_draw_indirect = gl_ext.MultiDrawElementsIndirect != nullptr;
+    }
+
+    // Immutable buffer storage.
+    if (gl_version_at_least(4, 4) || has_gl_extension("GL_ARB_buffer_storage"))
+    {
+        gl_ext.BufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+        gl_ext.has_buffer_storage = gl_ext.BufferStorage != nullptr;
+    }
+
+    // SPIR-V shaders.
+    if (gl_version_at_least(4, 6))
+    {
+        gl_ext.ShaderBinary = (PFNGLSHADERBINARYPROC)load("glShaderBinary");
+        gl_ext.SpecializeShader = (PFNGLSPECIALIZESHADERPROC)load("glSpecializeShader");
+    }
+    else if (has_gl_extension("GL_ARB_gl_spirv"))
+    {
+        gl_ext.ShaderBinary = (PFNGLSHADERBINARYPROC)load("glShaderBinary");
+        gl_ext.SpecializeShader = (PFNGLSPECIALIZESHADERPROC)load("glSpecializeShaderARB");
+    }
+
+    gl_ext.has_gl_spirv = gl_ext.ShaderBinary && gl_ext.SpecializeShader;
+}
+
+/*
+ * Buffer uploads that skip the bind when direct state access is available.
+ * The legacy path leaves the buffer bound to `target`.
+ */
+void named_buffer_data(GLenum target, unsigned int buffer, GLsizeiptr size,
+    const void* data, GLenum usage)
+{
+    if (gl_ext.has_direct_state_access)
+    {
+        gl_ext.NamedBufferData(buffer, size, data, usage);
+        return;
+    }
+
+    gl_state.bind_buffer(target, buffer);
+    glBufferData(target, size, data, usage);
+}
+
+void named_buffer_sub_data(GLenum target, unsigned int buffer, GLintptr offset,
+    GLsizeiptr size, const void* data)
+{
+    if (gl_ext.has_direct_state_access)
+    {
+        gl_ext.NamedBufferSubData(buffer, offset, size, data);
+        return;
+    }
+
+    gl_state.bind_buffer(target, buffer);
+    glBufferSubData(target, offset, size, data);
+}
+
+// Fill the buffer bound to `target` with data that never changes, as
+// immutable storage when supported.
+void immutable_buffer_data(GLenum target, GLsizeiptr size, const void* data)
+{
+    if (gl_ext.has_buffer_storage)
+        gl_ext.BufferStorage(target, size, data, 0);
+    else
+        glBufferData(target, size, data, GL_STATIC_DRAW);
+}
+
+#endif /* GL_EXTENSIONS_HPP */
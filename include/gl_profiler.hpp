@@ -0,0 +1,530 @@
+#ifndef GL_PROFILER_HPP
+#define GL_PROFILER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string_view>
+#include <tuple>
+
+#include <glad/glad.h>
+
+#include "gl_extensions.hpp"
+#include "shader.hpp"
+
+#ifndef GL_VERSION_4_0
+#define GL_DRAW_INDIRECT_BUFFER_BINDING 0x8F43
+#endif
+
+// GL calls made over one frame.
+struct GLCallStats
+{
+    unsigned int draw_calls = 0;
+
+    // Indirect draws are not included, their counts live on the GPU.
+    std::uint64_t triangles = 0;
+
+    unsigned int uniform_calls = 0;
+    unsigned int program_switches = 0;
+    unsigned int texture_binds = 0;
+    unsigned int buffer_uploads = 0;
+    std::uint64_t bytes_uploaded = 0;
+
+    // Uploads of the same bytes as the previous upload to the same range of
+    // the same buffer.
+    unsigned int redundant_uploads = 0;
+
+    void print(std::ostream& out) const;
+    static void print_csv_header(std::ostream& out);
+    void print_csv(std::ostream& out) const;
+};
+
+/*
+ * Counts GL calls by swapping glad's function pointers, and the matching ones
+ * in gl_ext, for wrappers that count and then call the original. Install after
+ * load_gl_extensions(). Every upload is hashed, so leave it uninstalled unless
+ * measuring. Writes to persistently mapped buffers are not calls, so they are
+ * not seen.
+ */
+class GLProfiler
+{
+public:
+    void install();
+    void uninstall();
+    bool is_installed() const;
+
+    // Also append each frame's counts to a CSV file.
+    bool open_csv(const std::filesystem::path& path);
+
+    // Counts for the frame so far.
+    const GLCallStats& frame_stats() const;
+
+    // Counts for the frame just drawn. Starts counting the next one.
+    GLCallStats end_frame();
+private:
+    bool installed = false;
+    GLCallStats stats;
+    std::ofstream csv;
+
+    // Hash of the last data uploaded to each buffer, offset and size.
+    std::map<std::tuple<unsigned int, GLintptr, GLsizeiptr>, std::uint64_t> upload_hashes;
+
+    struct Originals
+    {
+        PFNGLDRAWARRAYSPROC DrawArrays;
+        PFNGLDRAWELEMENTSPROC DrawElements;
+        PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced;
+        PFNGLDRAWELEMENTSINSTANCEDPROC DrawElementsInstanced;
+        PFNGLDRAWELEMENTSBASEVERTEXPROC DrawElementsBaseVertex;
+        PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXPROC DrawElementsInstancedBaseVertex;
+        PFNGLMULTIDRAWELEMENTSBASEVERTEXPROC MultiDrawElementsBaseVertex;
+        PFNGLUSEPROGRAMPROC UseProgram;
+        PFNGLBINDTEXTUREPROC BindTexture;
+        PFNGLUNIFORM1IPROC Uniform1i;
+        PFNGLUNIFORM1FPROC Uniform1f;
+        PFNGLUNIFORM3FPROC Uniform3f;
+        PFNGLUNIFORM4FPROC Uniform4f;
+        PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+        PFNGLBUFFERDATAPROC BufferData;
+        PFNGLBUFFERSUBDATAPROC BufferSubData;
+
+        // From gl_ext, null when unsupported.
+        PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect;
+        PFNGLPROGRAMUNIFORM1IPROC ProgramUniform1i;
+        PFNGLPROGRAMUNIFORM1FPROC ProgramUniform1f;
+        PFNGLPROGRAMUNIFORM3FPROC ProgramUniform3f;
+        PFNGLPROGRAMUNIFORMMATRIX4FVPROC ProgramUniformMatrix4fv;
+        PFNGLNAMEDBUFFERDATAPROC NamedBufferData;
+        PFNGLNAMEDBUFFERSUBDATAPROC NamedBufferSubData;
+        PFNGLBUFFERSTORAGEPROC BufferStorage;
+    };
+
+    Originals originals{};
+
+    void count_draw(GLenum mode, GLsizei count, GLsizei instances);
+    void count_upload(unsigned int buffer, GLintptr offset, GLsizeiptr size, const void* data);
+
+    // Buffer bound to `target`, for uploads that name the target.
+    static unsigned int bound_buffer(GLenum target);
+
+    // Wrappers installed in place of the originals.
+    static void APIENTRY draw_arrays(GLenum mode, GLint first, GLsizei count);
+    static void APIENTRY draw_elements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+    static void APIENTRY draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+    static void APIENTRY draw_elements_instanced(GLenum mode, GLsizei count, GLenum type,
+        const void* indices, GLsizei instances);
+    static void APIENTRY draw_elements_base_vertex(GLenum mode, GLsizei count, GLenum type,
+        const void* indices, GLint base_vertex);
+    static void APIENTRY draw_elements_instanced_base_vertex(GLenum mode, GLsizei count,
+        GLenum type, const void* indices, GLsizei instances, GLint base_vertex);
+    static void APIENTRY multi_draw_elements_base_vertex(GLenum mode, const GLsizei* counts,
+        GLenum type, const void* const* indices, GLsizei draw_count, const GLint* base_vertices);
+    static void APIENTRY multi_draw_elements_indirect(GLenum mode, GLenum type,
+        const void* indirect, GLsizei draw_count, GLsizei stride);
+    static void APIENTRY use_program(GLuint program);
+    static void APIENTRY bind_texture(GLenum target, GLuint texture);
+    static void APIENTRY uniform_1i(GLint location, GLint v0);
+    static void APIENTRY uniform_1f(GLint location, GLfloat v0);
+    static void APIENTRY uniform_3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+    static void APIENTRY uniform_4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+    static void APIENTRY uniform_matrix_4fv(GLint location, GLsizei count, GLboolean transpose,
+        const GLfloat* value);
+    static void APIENTRY program_uniform_1i(GLuint program, GLint location, GLint v0);
+    static void APIENTRY program_uniform_1f(GLuint program, GLint location, GLfloat v0);
+    static void APIENTRY program_uniform_3f(GLuint program, GLint location,
+        GLfloat v0, GLfloat v1, GLfloat v2);
+    static void APIENTRY program_uniform_matrix_4fv(GLuint program, GLint location,
+        GLsizei count, GLboolean transpose, const GLfloat* value);
+    static void APIENTRY buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+    static void APIENTRY buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size,
+        const void* data);
+    static void APIENTRY named_buffer_data(GLuint buffer, GLsizeiptr size, const void* data,
+        GLenum usage);
+    static void APIENTRY named_buffer_sub_data(GLuint buffer, GLintptr offset, GLsizeiptr size,
+        const void* data);
+    static void APIENTRY buffer_storage(GLenum target, GLsizeiptr size, const void* data,
+        GLbitfield flags);
+};
+
+GLProfiler gl_profiler;
+
+void GLCallStats::print(std::ostream& out) const
+{
+    out << "GL calls: " << draw_calls << " draws, "
+        << triangles << " triangles, "
+        << uniform_calls << " uniforms, "
+        << program_switches << " program switches, "
+        << texture_binds << " texture binds, "
+        << buffer_uploads << " uploads ("
+        << bytes_uploaded << " bytes, "
+        << redundant_uploads << " redundant)\n";
+}
+
+void GLCallStats::print_csv_header(std::ostream& out)
+{
+    out << "draw_calls,triangles,uniform_calls,program_switches,texture_binds,"
+        << "buffer_uploads,bytes_uploaded,redundant_uploads\n";
+}
+
+void GLCallStats::print_csv(std::ostream& out) const
+{
+    out << draw_calls << ',' << triangles << ',' << uniform_calls << ','
+        << program_switches << ',' << texture_binds << ',' << buffer_uploads << ','
+        << bytes_uploaded << ',' << redundant_uploads << '\n';
+}
+
+void GLProfiler::install()
+{
+    if (installed)
+        return;
+
+    originals.DrawArrays = glad_glDrawArrays;
+    originals.DrawElements = glad_glDrawElements;
+    originals.DrawArraysInstanced = glad_glDrawArraysInstanced;
+    originals.DrawElementsInstanced = glad_glDrawElementsInstanced;
+    originals.DrawElementsBaseVertex = glad_glDrawElementsBaseVertex;
+    originals.DrawElementsInstancedBaseVertex = glad_glDrawElementsInstancedBaseVertex;
+    originals.MultiDrawElementsBaseVertex = glad_glMultiDrawElementsBaseVertex;
+    originals.UseProgram = glad_glUseProgram;
+    originals.BindTexture = glad_glBindTexture;
+    originals.Uniform1i = glad_glUniform1i;
+    originals.Uniform1f = glad_glUniform1f;
+    originals.Uniform3f = glad_glUniform3f;
+    originals.Uniform4f = glad_glUniform4f;
+    originals.UniformMatrix4fv = glad_glUniformMatrix4fv;
+    originals.BufferData = glad_glBufferData;
+    originals.BufferSubData = glad_glBufferSubData;
+
+    originals.MultiDrawElementsIndirect = gl_ext.MultiDrawElementsIndirect;
+    originals.ProgramUniform1i = gl_ext.ProgramUniform1i;
+    originals.ProgramUniform1f = gl_ext.ProgramUniform1f;
+    originals.ProgramUniform3f = gl_ext.ProgramUniform3f;
+    originals.ProgramUniformMatrix4fv = gl_ext.ProgramUniformMatrix4fv;
+    originals.NamedBufferData = gl_ext.NamedBufferData;
+    originals.NamedBufferSubData = gl_ext.NamedBufferSubData;
+    originals.BufferStorage = gl_ext.BufferStorage;
+
+    glad_glDrawArrays = draw_arrays;
+    glad_glDrawElements = draw_elements;
+    glad_glDrawArraysInstanced = draw_arrays_instanced;
+    glad_glDrawElementsInstanced = draw_elements_instanced;
+    glad_glDrawElementsBaseVertex = draw_elements_base_vertex;
+    glad_glDrawElementsInstancedBaseVertex = draw_elements_instanced_base_vertex;
+    glad_glMultiDrawElementsBaseVertex = multi_draw_elements_base_vertex;
+    glad_glUseProgram = use_program;
+    glad_glBindTexture = bind_texture;
+    glad_glUniform1i = uniform_1i;
+    glad_glUniform1f = uniform_1f;
+    glad_glUniform3f = uniform_3f;
+    glad_glUniform4f = uniform_4f;
+    glad_glUniformMatrix4fv = uniform_matrix_4fv;
+    glad_glBufferData = buffer_data;
+    glad_glBufferSubData = buffer_sub_data;
+
+    // Leave unsupported entry points null so capability checks still hold.
+    if (gl_ext.MultiDrawElementsIndirect)
+        gl_ext.MultiDrawElementsIndirect = multi_draw_elements_indirect;
+    if (gl_ext.ProgramUniform1i)
+        gl_ext.ProgramUniform1i = program_uniform_1i;
+    if (gl_ext.ProgramUniform1f)
+        gl_ext.ProgramUniform1f = program_uniform_1f;
+    if (gl_ext.ProgramUniform3f)
+        gl_ext.ProgramUniform3f = program_uniform_3f;
+    if (gl_ext.ProgramUniformMatrix4fv)
+        gl_ext.ProgramUniformMatrix4fv = program_uniform_matrix_4fv;
+    if (gl_ext.NamedBufferData)
+        gl_ext.NamedBufferData = named_buffer_data;
+    if (gl_ext.NamedBufferSubData)
+        gl_ext.NamedBufferSubData = named_buffer_sub_data;
+    if (gl_ext.BufferStorage)
+        gl_ext.BufferStorage = buffer_storage;
+
+    installed = true;
+}
+
+void GLProfiler::uninstall()
+{
+    if (!installed)
+        return;
+
+    glad_glDrawArrays = originals.DrawArrays;
+    glad_glDrawElements = originals.DrawElements;
+    glad_glDrawArraysInstanced = originals.DrawArraysInstanced;
+    glad_glDrawElementsInstanced = originals.DrawElementsInstanced;
+    glad_glDrawElementsBaseVertex = originals.DrawElementsBaseVertex;
+    glad_glDrawElementsInstancedBaseVertex = originals.DrawElementsInstancedBaseVertex;
+    glad_glMultiDrawElementsBaseVertex = originals.MultiDrawElementsBaseVertex;
+    glad_glUseProgram = originals.UseProgram;
+    glad_glBindTexture = originals.BindTexture;
+    glad_glUniform1i = originals.Uniform1i;
+    glad_glUniform1f = originals.Uniform1f;
+    glad_glUniform3f = originals.Uniform3f;
+    glad_glUniform4f = originals.Uniform4f;
+    glad_glUniformMatrix4fv = originals.UniformMatrix4fv;
+    glad_glBufferData = originals.BufferData;
+    glad_glBufferSubData = originals.BufferSubData;
+
+    gl_ext.MultiDrawElementsIndirect = originals.MultiDrawElementsIndirect;
+    gl_ext.ProgramUniform1i = originals.ProgramUniform1i;
+    gl_ext.ProgramUniform1f = originals.ProgramUniform1f;
+    gl_ext.ProgramUniform3f = originals.ProgramUniform3f;
+    gl_ext.ProgramUniformMatrix4fv = originals.ProgramUniformMatrix4fv;
+    gl_ext.NamedBufferData = originals.NamedBufferData;
+    gl_ext.NamedBufferSubData = originals.NamedBufferSubData;
+    gl_ext.BufferStorage = originals.BufferStorage;
+
+    installed = false;
+}
+
+bool GLProfiler::is_installed() const
+{
+    return installed;
+}
+
+bool GLProfiler::open_csv(const std::filesystem::path& path)
+{
+    csv.open(path);
+    if (!csv)
+    {
+        std::cerr << "GLProfiler::open_csv: failed to open " << path << '\n';
+        return false;
+    }
+
+    GLCallStats::print_csv_header(csv);
+    return true;
+}
+
+const GLCallStats& GLProfiler::frame_stats() const
+{
+    return stats;
+}
+
+GLCallStats GLProfiler::end_frame()
+{
+    GLCallStats frame = stats;
+    stats = GLCallStats{};
+
+    if (csv.is_open())
+        frame.print_csv(csv);
+
+    return frame;
+}
+
+void GLProfiler::count_draw(GLenum mode, GLsizei count, GLsizei instances)
+{
+    stats.draw_calls++;
+
+    std::uint64_t triangles = 0;
+    if (mode == GL_TRIANGLES)
+        triangles = count / 3;
+    else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count >= 3)
+        triangles = count - 2;
+
+    stats.triangles += triangles * instances;
+}
+
+void GLProfiler::count_upload(unsigned int buffer, GLintptr offset, GLsizeiptr size,
+    const void* data)
+{
+    stats.buffer_uploads++;
+
+    // Allocations without data only reserve storage.
+    if (!data)
+        return;
+
+    stats.bytes_uploaded += size;
+
+    std::uint64_t hash = hash_fnv1a(std::string_view((const char*)data, size));
+    auto [it, inserted] = upload_hashes.try_emplace({buffer, offset, size}, hash);
+    if (!inserted)
+    {
+        if (it->second == hash)
+            stats.redundant_uploads++;
+        it->second = hash;
+    }
+}
+
+unsigned int GLProfiler::bound_buffer(GLenum target)
+{
+    GLenum binding = 0;
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER: binding = GL_ARRAY_BUFFER_BINDING; break;
+    case GL_ELEMENT_ARRAY_BUFFER: binding = GL_ELEMENT_ARRAY_BUFFER_BINDING; break;
+    case GL_UNIFORM_BUFFER: binding = GL_UNIFORM_BUFFER_BINDING; break;
+    case GL_DRAW_INDIRECT_BUFFER: binding = GL_DRAW_INDIRECT_BUFFER_BINDING; break;
+    default: return 0;
+    }
+
+    int buffer = 0;
+    glGetIntegerv(binding, &buffer);
+    return buffer;
+}
+
+void APIENTRY GLProfiler::draw_arrays(GLenum mode, GLint first, GLsizei count)
+{
+    gl_profiler.count_draw(mode, count, 1);
+    gl_profiler.originals.DrawArrays(mode, first, count);
+}
+
+void APIENTRY GLProfiler::draw_elements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+    gl_profiler.count_draw(mode, count, 1);
+    gl_profiler.originals.DrawElements(mode, count, type, indices);
+}
+
+void APIENTRY GLProfiler::draw_arrays_instanced(GLenum mode, GLint first, GLsizei count,
+    GLsizei instances)
+{
+    gl_profiler.count_draw(mode, count, instances);
+    gl_profiler.originals.DrawArraysInstanced(mode, first, count, instances);
+}
+
+void APIENTRY GLProfiler::draw_elements_instanced(GLenum mode, GLsizei count, GLenum type,
+    const void* indices, GLsizei instances)
+{
+    gl_profiler.count_draw(mode, count, instances);
+    gl_profiler.originals.DrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+void APIENTRY GLProfiler::draw_elements_base_vertex(GLenum mode, GLsizei count, GLenum type,
+    const void* indices, GLint base_vertex)
+{
+    gl_profiler.count_draw(mode, count, 1);
+    gl_profiler.originals.DrawElementsBaseVertex(mode, count, type, indices, base_vertex);
+}
+
+void APIENTRY GLProfiler::draw_elements_instanced_base_vertex(GLenum mode, GLsizei count,
+    GLenum type, const void* indices, GLsizei instances, GLint base_vertex)
+{
+    gl_profiler.count_draw(mode, count, instances);
+    gl_profiler.originals.DrawElementsInstancedBaseVertex(mode, count, type, indices, instances,
+        base_vertex);
+}
+
+void APIENTRY GLProfiler::multi_draw_elements_base_vertex(GLenum mode, const GLsizei* counts,
+    GLenum type, const void* const* indices, GLsizei draw_count, const GLint* base_vertices)
+{
+    // One call, however many ranges it draws.
+    GLsizei count = 0;
+    for (GLsizei i = 0; i < draw_count; i++)
+        count += counts[i];
+    gl_profiler.count_draw(mode, count, 1);
+
+    gl_profiler.originals.MultiDrawElementsBaseVertex(mode, counts, type, indices, draw_count,
+        base_vertices);
+}
+
+void APIENTRY GLProfiler::multi_draw_elements_indirect(GLenum mode, GLenum type,
+    const void* indirect, GLsizei draw_count, GLsizei stride)
+{
+    gl_profiler.stats.draw_calls++;
+    gl_profiler.originals.MultiDrawElementsIndirect(mode, type, indirect, draw_count, stride);
+}
+
+void APIENTRY GLProfiler::use_program(GLuint program)
+{
+    gl_profiler.stats.program_switches++;
+    gl_profiler.originals.UseProgram(program);
+}
+
+void APIENTRY GLProfiler::bind_texture(GLenum target, GLuint texture)
+{
+    gl_profiler.stats.texture_binds++;
+    gl_profiler.originals.BindTexture(target, texture);
+}
+
+void APIENTRY GLProfiler::uniform_1i(GLint location, GLint v0)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.Uniform1i(location, v0);
+}
+
+void APIENTRY GLProfiler::uniform_1f(GLint location, GLfloat v0)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.Uniform1f(location, v0);
+}
+
+void APIENTRY GLProfiler::uniform_3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.Uniform3f(location, v0, v1, v2);
+}
+
+void APIENTRY GLProfiler::uniform_4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.Uniform4f(location, v0, v1, v2, v3);
+}
+
+void APIENTRY GLProfiler::uniform_matrix_4fv(GLint location, GLsizei count, GLboolean transpose,
+    const GLfloat* value)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.UniformMatrix4fv(location, count, transpose, value);
+}
+
+void APIENTRY GLProfiler::program_uniform_1i(GLuint program, GLint location, GLint v0)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.ProgramUniform1i(program, location, v0);
+}
+
+void APIENTRY GLProfiler::program_uniform_1f(GLuint program, GLint location, GLfloat v0)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.ProgramUniform1f(program, location, v0);
+}
+
+void APIENTRY GLProfiler::program_uniform_3f(GLuint program, GLint location,
+    GLfloat v0, GLfloat v1, GLfloat v2)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.ProgramUniform3f(program, location, v0, v1, v2);
+}
+
+void APIENTRY GLProfiler::program_uniform_matrix_4fv(GLuint program, GLint location,
+    GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+    gl_profiler.stats.uniform_calls++;
+    gl_profiler.originals.ProgramUniformMatrix4fv(program, location, count, transpose, value);
+}
+
+void APIENTRY GLProfiler::buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+    gl_profiler.count_upload(bound_buffer(target), 0, size, data);
+    gl_profiler.originals.BufferData(target, size, data, usage);
+}
+
+void APIENTRY GLProfiler::buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size,
+    const void* data)
+{
+    gl_profiler.count_upload(bound_buffer(target), offset, size, data);
+    gl_profiler.originals.BufferSubData(target, offset, size, data);
+}
+
+void APIENTRY GLProfiler::named_buffer_data(GLuint buffer, GLsizeiptr size, const void* data,
+    GLenum usage)
+{
+    gl_profiler.count_upload(buffer, 0, size, data);
+    gl_profiler.originals.NamedBufferData(buffer, size, data, usage);
+}
+
+void APIENTRY GLProfiler::named_buffer_sub_data(GLuint buffer, GLintptr offset, GLsizeiptr size,
+    const void* data)
+{
+    gl_profiler.count_upload(buffer, offset, size, data);
+    gl_profiler.originals.NamedBufferSubData(buffer, offset, size, data);
+}
+
+void APIENTRY GLProfiler::buffer_storage(GLenum target, GLsizeiptr size, const void* data,
+    GLbitfield flags)
+{
+    gl_profiler.count_upload(bound_buffer(target), 0, size, data);
+    gl_profiler.originals.BufferStorage(target, size, data, flags);
+}
+
+#endif /* GL_PROFILER_HPP */
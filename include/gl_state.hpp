@@ -0,0 +1,245 @@
+#ifndef GL_STATE_HPP
+#define GL_STATE_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Binding calls made and dropped through GLState.
+struct GLStateStats
+{
+    unsigned int issued = 0;
+    unsigned int suppressed = 0;
+};
+
+/*
+ * Shadow copy of the binding state draw code changes most: the current
+ * program, vertex array, buffer bindings, active texture unit and the texture
+ * bound to each unit. Binds that would change nothing are dropped.
+ *
+ * The copy is only accurate while all of this state is bound through
+ * gl_state. Call invalidate() after binding any of it directly.
+ */
+class GLState
+{
+public:
+    void use_program(unsigned int program);
+    void bind_vertex_array(unsigned int vertex_array);
+    void bind_buffer(GLenum target, unsigned int buffer);
+
+    // Also binds the buffer to the generic `target` binding, as GL does.
+    void bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer);
+    void bind_buffer_range(GLenum target, unsigned int index, unsigned int buffer,
+        GLintptr offset, GLsizeiptr size);
+
+    void active_texture(unsigned int unit);
+
+    // Bind a texture to a unit, making that unit active if it is not.
+    void bind_texture(unsigned int unit, GLenum target, unsigned int texture);
+
+    // Deleting a bound object resets its bindings to zero and frees the name
+    // for reuse. Call these before glDelete*.
+    void forget_program(unsigned int program);
+    void forget_vertex_array(unsigned int vertex_array);
+    void forget_buffer(unsigned int buffer);
+    void forget_texture(unsigned int texture);
+
+    // Assume nothing about the current bindings.
+    void invalidate();
+
+    // Counts for the frame so far.
+    const GLStateStats& frame_stats() const;
+
+    // Counts for the frame just drawn. Starts counting the next one.
+    GLStateStats end_frame();
+private:
+    static constexpr unsigned int UNKNOWN = ~0u;
+
+    struct BufferBinding
+    {
+        GLenum target;
+        unsigned int buffer;
+    };
+
+    struct TextureBinding
+    {
+        unsigned int unit;
+        GLenum target;
+        unsigned int texture;
+    };
+
+    unsigned int program = UNKNOWN;
+    unsigned int vertex_array = UNKNOWN;
+    unsigned int active_unit = UNKNOWN;
+
+    // Bindings not listed are unknown.
+    std::vector<BufferBinding> buffers;
+    std::vector<TextureBinding> textures;
+
+    GLStateStats stats;
+
+    // Record `value` as current. Returns false, counting a suppressed call,
+    // if it already was.
+    bool update(unsigned int& current, unsigned int value);
+
+    unsigned int& buffer_binding(GLenum target);
+
+    // The element array binding belongs to the vertex array, so it is
+    // unknown after switching vertex arrays.
+    void forget_element_array_buffer();
+
+    unsigned int& texture_binding(unsigned int unit, GLenum target);
+};
+
+GLState gl_state;
+
+void GLState::use_program(unsigned int program_)
+{
+    if (update(program, program_))
+        glUseProgram(program_);
+}
+
+void GLState::bind_vertex_array(unsigned int vertex_array_)
+{
+    if (!update(vertex_array, vertex_array_))
+        return;
+
+    glBindVertexArray(vertex_array_);
+    forget_element_array_buffer();
+}
+
+void GLState::bind_buffer(GLenum target, unsigned int buffer)
+{
+    if (update(buffer_binding(target), buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer)
+{
+    // Indexed bindings are not tracked, so this is always issued.
+    glBindBufferBase(target, index, buffer);
+    stats.issued++;
+    buffer_binding(target) = buffer;
+}
+
+void GLState::bind_buffer_range(GLenum target, unsigned int index, unsigned int buffer,
+    GLintptr offset, GLsizeiptr size)
+{
+    glBindBufferRange(target, index, buffer, offset, size);
+    stats.issued++;
+    buffer_binding(target) = buffer;
+}
+
+void GLState::active_texture(unsigned int unit)
+{
+    if (update(active_unit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::bind_texture(unsigned int unit, GLenum target, unsigned int texture)
+{
+    unsigned int& current = texture_binding(unit, target);
+    if (current == texture)
+    {
+        stats.suppressed++;
+        return;
+    }
+
+    active_texture(unit);
+    glBindTexture(target, texture);
+    stats.issued++;
+    current = texture;
+}
+
+void GLState::forget_program(unsigned int program_)
+{
+    if (program == program_)
+        program = UNKNOWN;
+}
+
+void GLState::forget_vertex_array(unsigned int vertex_array_)
+{
+    if (vertex_array == vertex_array_)
+    {
+        vertex_array = 0;
+        forget_element_array_buffer();
+    }
+}
+
+void GLState::forget_buffer(unsigned int buffer)
+{
+    for (auto& binding : buffers)
+        if (binding.buffer == buffer)
+            binding.buffer = 0;
+}
+
+void GLState::forget_texture(unsigned int texture)
+{
+    for (auto& binding : textures)
+        if (binding.texture == texture)
+            binding.texture = 0;
+}
+
+void GLState::invalidate()
+{
+    program = UNKNOWN;
+    vertex_array = UNKNOWN;
+    active_unit = UNKNOWN;
+    buffers.clear();
+    textures.clear();
+}
+
+const GLStateStats& GLState::frame_stats() const
+{
+    return stats;
+}
+
+GLStateStats GLState::end_frame()
+{
+    GLStateStats frame = stats;
+    stats = GLStateStats{};
+    return frame;
+}
+
+bool GLState::update(unsigned int& current, unsigned int value)
+{
+    if (current == value)
+    {
+        stats.suppressed++;
+        return false;
+    }
+
+    current = value;
+    stats.issued++;
+    return true;
+}
+
+unsigned int& GLState::buffer_binding(GLenum target)
+{
+    for (auto& binding : buffers)
+        if (binding.target == target)
+            return binding.buffer;
+
+    buffers.push_back({target, UNKNOWN});
+    return buffers.back().buffer;
+}
+
+void GLState::forget_element_array_buffer()
+{
+    buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+        [](const BufferBinding& binding) { return binding.target == GL_ELEMENT_ARRAY_BUFFER; }),
+        buffers.end());
+}
+
+unsigned int& GLState::texture_binding(unsigned int unit, GLenum target)
+{
+    for (auto& binding : textures)
+        if (binding.unit == unit && binding.target == target)
+            return binding.texture;
+
+    textures.push_back({unit, target, UNKNOWN});
+    return textures.back().texture;
+}
+
+#endif /* GL_STATE_HPP */
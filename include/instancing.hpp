@@ -0,0 +1,92 @@
+#ifndef INSTANCING_HPP
+#define INSTANCING_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gl_extensions.hpp"
+
+/*
+ * Per-instance model matrices for instanced draws. The matrices feed a mat4
+ * vertex attribute spanning four consecutive locations that advances once per
+ * instance, so a single draw call covers every instance. Declare it in the
+ * vertex shader as e.g.
+ *
+ *     layout (location = 2) in mat4 in_model;
+ *
+ * Vertex array and buffer bindings go through gl_state.
+ */
+class InstanceBuffer
+{
+public:
+    // Attach to `vao`, feeding the attribute at `location` to `location + 3`.
+    void init(unsigned int vao, unsigned int location);
+    void deinit();
+
+    // Replace the transforms. The buffer is respecified on every call so the
+    // driver never has to wait for draws still reading the old contents.
+    void update(const std::vector<glm::mat4>& transforms, GLenum usage = GL_STREAM_DRAW);
+
+    std::size_t size() const;
+
+    // Draw `count` vertices starting at `first` once per instance.
+    void draw_arrays(GLenum mode, GLint first, GLsizei count) const;
+private:
+    unsigned int vao = 0;
+    unsigned int vbo = 0;
+    std::size_t count = 0;
+};
+
+void InstanceBuffer::init(unsigned int vao_, unsigned int location)
+{
+    vao = vao_;
+    glGenBuffers(1, &vbo);
+
+    gl_state.bind_vertex_array(vao);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, vbo);
+
+    // A mat4 attribute is four vec4 columns.
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(location + column);
+        glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+            (void*)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location + column, 1);
+    }
+
+    gl_state.bind_vertex_array(0);
+}
+
+void InstanceBuffer::deinit()
+{
+    gl_state.forget_buffer(vbo);
+    glDeleteBuffers(1, &vbo);
+    vbo = 0;
+    count = 0;
+}
+
+void InstanceBuffer::update(const std::vector<glm::mat4>& transforms, GLenum usage)
+{
+    named_buffer_data(GL_ARRAY_BUFFER, vbo, sizeof(glm::mat4) * transforms.size(),
+        transforms.data(), usage);
+    count = transforms.size();
+}
+
+std::size_t InstanceBuffer::size() const
+{
+    return count;
+}
+
+void InstanceBuffer::draw_arrays(GLenum mode, GLint first, GLsizei count_) const
+{
+    if (count == 0)
+        return;
+
+    gl_state.bind_vertex_array(vao);
+    glDrawArraysInstanced(mode, first, count_, count);
+}
+
+#endif /* INSTANCING_HPP */
@@ -1,17 +1,91 @@
 #ifndef LIGHTS_HPP
 #define LIGHTS_HPP
 
+#include <cstddef>
+#include <iostream>
 #include <memory>
 #include <vector>
 
 #include <glm/glm.hpp>
 
+#include "render_queue.hpp"
+#include "ring_buffer.hpp"
+#include "shader.hpp"
 #include "shapes.hpp"
 
 struct DirectionalLight;
 class PointLight;
 struct Spotlight;
 
+// Maximum number of point lights the "Lighting" uniform block holds. Shaders
+// declare the block with this array size and loop over NUM_POINT_LIGHTS.
+constexpr std::size_t MAX_POINT_LIGHTS = 16;
+
+// std140 mirrors of the light structs in the "Lighting" uniform block. Every
+// vec3 starts on a 16 byte boundary, floats fill the gaps where they can.
+struct DirectionalLightStd140
+{
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+
+struct PointLightStd140
+{
+    glm::vec3 position;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float pad3[2];
+};
+
+struct SpotlightStd140
+{
+    glm::vec3 position;
+    float pad0;
+    glm::vec3 direction;
+    float inner_cutoff;
+    float outer_cutoff;
+    float pad1[3];
+    glm::vec3 ambient;
+    float pad2;
+    glm::vec3 diffuse;
+    float pad3;
+    glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float pad4[2];
+};
+
+struct LightingBlockStd140
+{
+    DirectionalLightStd140 dir_light;
+    SpotlightStd140 spotlight;
+    PointLightStd140 point_lights[MAX_POINT_LIGHTS];
+};
+
+static_assert(sizeof(DirectionalLightStd140) == 64, "std140 DirectionalLight size");
+static_assert(sizeof(PointLightStd140) == 80, "std140 PointLight size");
+static_assert(offsetof(PointLightStd140, constant) == 60, "std140 PointLight layout");
+static_assert(sizeof(SpotlightStd140) == 112, "std140 Spotlight size");
+static_assert(offsetof(SpotlightStd140, ambient) == 48, "std140 Spotlight layout");
+static_assert(offsetof(SpotlightStd140, constant) == 92, "std140 Spotlight layout");
+static_assert(offsetof(LightingBlockStd140, point_lights) == 176, "std140 Lighting layout");
+
+// Lights present in the scene. Pass nullptr for a directional light or
+// spotlight the scene doesn't have.
 struct SceneLighting
 {
     SceneLighting(DirectionalLight* dir_,
@@ -21,9 +95,35 @@ struct SceneLighting
     {
     }
 
+    void init();
+    void deinit();
+
+    // Write the "Lighting" block for this frame and bind it.
+    void update(RingBuffer& ring);
+
+    // Queue one instanced draw of a cube marker for every point light, drawn
+    // in the light's color. The shader takes the cube position at location 0
+    // and the per-instance attributes of PointLightMarker from location 1.
+    void submit_markers(RenderQueue& queue, RenderPass pass, Shader* shader);
+
     DirectionalLight* dir;
     std::vector<std::shared_ptr<PointLight>> points;
     Spotlight* spot;
+private:
+    LightingBlockStd140 block{};
+
+    // Per-instance attributes of a point light marker.
+    struct PointLightMarker
+    {
+        glm::vec4 position_scale;  // Position, then scale factor.
+        glm::vec3 color;
+    };
+
+    // One cube shared by every marker, plus the marker instances.
+    unsigned int marker_vao = 0;
+    unsigned int marker_vbo = 0;
+    unsigned int marker_instance_vbo = 0;
+    std::vector<PointLightMarker> markers;
 };
 
 struct DirectionalLight
@@ -70,10 +170,6 @@ public:
     {
     }
 
-    void init();
-    void deinit();
-    void draw();
-
     glm::vec3 position;
     glm::vec3 color;
     float scale_factor;
@@ -85,40 +181,8 @@ public:
     float constant;
     float linear;
     float quadratic;
-private:
-    unsigned int vao;
-    unsigned int vbo;
 };
 
-void PointLight::init()
-{
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-
-    glBindVertexArray(vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * cube_vertices.size(), cube_vertices.data(), GL_STATIC_DRAW);
-
-    // Specify vertex data format.
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glBindVertexArray(0);
-}
-
-void PointLight::deinit()
-{
-    glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
-}
-
-void PointLight::draw()
-{
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-}
-
 struct Spotlight
 {
     Spotlight(
@@ -166,4 +230,136 @@ struct Spotlight
     float quadratic;
 };
 
+void SceneLighting::init()
+{
+    // Point light markers.
+    glGenVertexArrays(1, &marker_vao);
+    glGenBuffers(1, &marker_vbo);
+    glGenBuffers(1, &marker_instance_vbo);
+
+    gl_state.bind_vertex_array(marker_vao);
+
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, marker_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * cube_vertices.size(), cube_vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Advance once per marker rather than once per vertex.
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, marker_instance_vbo);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(PointLightMarker),
+        (void*)offsetof(PointLightMarker, position_scale));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(PointLightMarker),
+        (void*)offsetof(PointLightMarker, color));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
+    gl_state.bind_vertex_array(0);
+}
+
+void SceneLighting::deinit()
+{
+    gl_state.forget_vertex_array(marker_vao);
+    gl_state.forget_buffer(marker_vbo);
+    gl_state.forget_buffer(marker_instance_vbo);
+    glDeleteVertexArrays(1, &marker_vao);
+    glDeleteBuffers(1, &marker_vbo);
+    glDeleteBuffers(1, &marker_instance_vbo);
+    marker_vao = 0;
+    marker_vbo = 0;
+    marker_instance_vbo = 0;
+}
+
+void SceneLighting::update(RingBuffer& ring)
+{
+    // Directional light properties.
+    if (dir)
+    {
+        block.dir_light.direction = dir->direction;
+
+        block.dir_light.ambient = dir->ambient;
+        block.dir_light.diffuse = dir->diffuse;
+        block.dir_light.specular = dir->specular;
+    }
+    else
+    {
+        block.dir_light = DirectionalLightStd140{};
+    }
+
+    // Point light properties.
+    if (points.size() > MAX_POINT_LIGHTS)
+    {
+        std::cerr << "SceneLighting::update: " << points.size()
+            << " point lights exceeds MAX_POINT_LIGHTS (" << MAX_POINT_LIGHTS << ")\n";
+    }
+    for (std::size_t i = 0; i < points.size() && i < MAX_POINT_LIGHTS; i++)
+    {
+        if (!points[i])
+        {
+            std::cerr << "SceneLighting::update: PointLight pointer is null.\n";
+            continue;
+        }
+
+        PointLightStd140& point = block.point_lights[i];
+        point.position = points[i]->position;
+        point.ambient = points[i]->ambient;
+        point.diffuse = points[i]->color * points[i]->diffuse;
+        point.specular = points[i]->color * points[i]->specular;
+        point.constant = points[i]->constant;
+        point.linear = points[i]->linear;
+        point.quadratic = points[i]->quadratic;
+    }
+
+    // Spotlight properties.
+    if (spot)
+    {
+        block.spotlight.position = spot->position;
+        block.spotlight.direction = spot->direction;
+
+        block.spotlight.inner_cutoff = glm::cos(glm::radians(spot->inner_cutoff));
+        block.spotlight.outer_cutoff = glm::cos(glm::radians(spot->outer_cutoff));
+
+        block.spotlight.ambient = spot->ambient;
+        block.spotlight.diffuse = spot->diffuse;
+        block.spotlight.specular = spot->specular;
+
+        block.spotlight.constant = spot->constant;
+        block.spotlight.linear = spot->linear;
+        block.spotlight.quadratic = spot->quadratic;
+    }
+    else
+    {
+        block.spotlight = SpotlightStd140{};
+    }
+
+    // Write the whole block once for every program that declares it.
+    ring.bind(LIGHTING_BLOCK_BINDING, &block, sizeof(LightingBlockStd140));
+}
+
+void SceneLighting::submit_markers(RenderQueue& queue, RenderPass pass, Shader* shader)
+{
+    markers.clear();
+    for (const auto& point : points)
+    {
+        if (point)
+            markers.push_back({glm::vec4(point->position, point->scale_factor), point->color});
+    }
+
+    if (markers.empty())
+        return;
+
+    // Respecify the buffer so the upload never waits on last frame's draw.
+    named_buffer_data(GL_ARRAY_BUFFER, marker_instance_vbo,
+        sizeof(PointLightMarker) * markers.size(), markers.data(), GL_STREAM_DRAW);
+
+    DrawItem item;
+    item.shader = shader;
+    item.vao = marker_vao;
+    item.count = 36;
+    item.instance_count = markers.size();
+
+    queue.submit(pass, item);
+}
+
 #endif /* LIGHTS_HPP */
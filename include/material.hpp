@@ -0,0 +1,131 @@
+#ifndef MATERIAL_HPP
+#define MATERIAL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "shader.hpp"
+
+// What a material samples a texture as. Each slot is bound to its own fixed
+// texture unit.
+enum class TextureSlot : unsigned int
+{
+    DIFFUSE,
+    SPECULAR,
+};
+
+constexpr std::size_t NUM_TEXTURE_SLOTS = 2;
+
+// Texture unit of the sampler reading a slot, see sampler_bindings.
+constexpr std::array<unsigned int, NUM_TEXTURE_SLOTS> texture_slot_units = {
+    DIFFUSE_TEXTURE_UNIT,
+    SPECULAR_TEXTURE_UNIT,
+};
+
+enum MaterialFlags : unsigned int
+{
+    // Submitted to the shadow pass. Set by default.
+    MATERIAL_CASTS_SHADOWS = 1 << 0,
+};
+
+using MaterialId = std::uint32_t;
+
+constexpr MaterialId NO_MATERIAL = ~MaterialId(0);
+
+// Surface state shared by every draw using it.
+struct Material
+{
+    // Texture ID per slot, 0 if the slot is empty. Empty slots sample as
+    // black, so a mesh without a specular map has no highlights.
+    std::array<unsigned int, NUM_TEXTURE_SLOTS> textures{};
+    float shininess = 32.0f;
+    unsigned int flags = MATERIAL_CASTS_SHADOWS;
+
+    void set_texture(TextureSlot slot, unsigned int texture);
+    unsigned int get_texture(TextureSlot slot) const;
+
+    bool casts_shadows() const;
+
+    // Bind the texture of every slot `shader` samples, unbinding the unit
+    // of an empty slot, and set its material.shininess through
+    // `shininess_handle`.
+    void apply(const Shader& shader, UniformHandle shininess_handle) const;
+
+    bool operator==(const Material& other) const;
+};
+
+/*
+ * Every material in use, each stored once. Materials are added while scenes
+ * load and only read afterwards, so draws can be recorded on any thread.
+ */
+class MaterialLibrary
+{
+public:
+    // ID of an equal material, adding it first if none exists.
+    MaterialId add(const Material& material);
+
+    const Material& get(MaterialId id) const;
+    std::size_t size() const;
+private:
+    std::vector<Material> materials;
+};
+
+MaterialLibrary material_library;
+
+void Material::set_texture(TextureSlot slot, unsigned int texture)
+{
+    textures[(std::size_t)slot] = texture;
+}
+
+unsigned int Material::get_texture(TextureSlot slot) const
+{
+    return textures[(std::size_t)slot];
+}
+
+bool Material::casts_shadows() const
+{
+    return flags & MATERIAL_CASTS_SHADOWS;
+}
+
+void Material::apply(const Shader& shader, UniformHandle shininess_handle) const
+{
+    for (std::size_t slot = 0; slot < NUM_TEXTURE_SLOTS; slot++)
+    {
+        unsigned int unit = texture_slot_units[slot];
+        if (shader.uses_texture_unit(unit))
+            gl_state.bind_texture(unit, GL_TEXTURE_2D, textures[slot]);
+    }
+
+    shader.set_float(shininess_handle, shininess);
+}
+
+bool Material::operator==(const Material& other) const
+{
+    return textures == other.textures &&
+        shininess == other.shininess &&
+        flags == other.flags;
+}
+
+MaterialId MaterialLibrary::add(const Material& material)
+{
+    for (std::size_t i = 0; i < materials.size(); i++)
+        if (materials[i] == material)
+            return i;
+
+    materials.push_back(material);
+    return materials.size() - 1;
+}
+
+const Material& MaterialLibrary::get(MaterialId id) const
+{
+    return materials[id];
+}
+
+std::size_t MaterialLibrary::size() const
+{
+    return materials.size();
+}
+
+#endif /* MATERIAL_HPP */
@@ -1,15 +1,17 @@
 #ifndef MESH_HPP
 #define MESH_HPP
 
+#include <algorithm>
 #include <filesystem>
-#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "lights.hpp"
+#include "bounds.hpp"
+#include "material.hpp"
+#include "render_queue.hpp"
 #include "shader.hpp"
 
 struct Vertex
@@ -22,58 +24,69 @@ struct Vertex
 struct Texture
 {
     std::size_t id;
-    std::string type;
+    TextureSlot slot;
     std::filesystem::path path;
 };
 
+// Point attributes 0 to 2 at the fields of Vertex in the bound
+// GL_ARRAY_BUFFER, for the bound vertex array.
+void set_vertex_attributes();
+
 class Mesh
 {
 public:
     Mesh(std::vector<Vertex> vertices_,
         std::vector<unsigned int> indices_,
-        std::vector<Texture> textures_,
-        SceneLighting* scene_lighting_) :
+        MaterialId material_) :
             vertices(vertices_),
             indices(indices_),
-            textures(textures_),
-            sl(scene_lighting_)
+            material(material_)
     {
+        compute_bounds();
     }
 
-    void init();
-    void deinit();
-    void draw(Shader* shader);
+    // Draw from `vao`, whose buffers hold the mesh's indices from
+    // `first_index` on and its vertices from `base_vertex` on, shared with
+    // other meshes.
+    void set_range(unsigned int vao, std::size_t first_index, GLint base_vertex);
+
+    void submit(RenderQueue& queue,
+        RenderPass pass,
+        Shader* shader,
+        const glm::mat4& model) const;
+
+    // Set the mesh's material, and add the depth map if set, on a draw.
+    void add_material(DrawItem& item) const;
 
     void set_depth_map(unsigned int);
-private:
-    SceneLighting* sl;
 
+    const std::vector<Vertex>& get_vertices() const;
+    const std::vector<unsigned int>& get_indices() const;
+    MaterialId get_material() const;
+
+    // Bounds of the vertices, in model space.
+    const BoundingBox& get_bounding_box() const;
+    const BoundingSphere& get_bounding_sphere() const;
+private:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    MaterialId material;
+
+    BoundingBox bounding_box;
+    BoundingSphere bounding_sphere;
 
-    unsigned int vao;
-    unsigned int vbo;
-    unsigned int ebo;
+    void compute_bounds();
+
+    unsigned int vao = 0;
+    std::size_t first_index = 0;
+    GLint base_vertex = 0;
 
     unsigned int depth_map;
     bool depth_map_set = false;
 };
 
-void Mesh::init()
+void set_vertex_attributes()
 {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
-
     // Vertex positions.
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -83,121 +96,98 @@ void Mesh::init()
     // Vertex textures coordinates.
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coords));
-
-    glBindVertexArray(0);
 }
 
-void Mesh::deinit()
+void Mesh::set_range(unsigned int vao_, std::size_t first_index_, GLint base_vertex_)
 {
-    glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
-    glDeleteBuffers(1, &ebo);
+    vao = vao_;
+    first_index = first_index_;
+    base_vertex = base_vertex_;
 }
 
-void Mesh::draw(Shader* shader)
+void Mesh::submit(RenderQueue& queue,
+    RenderPass pass,
+    Shader* shader,
+    const glm::mat4& model) const
 {
-    // Set shader attributes.
     if (!shader)
     {
-        std::cerr << "Room::draw: SceneLighting->Spotlight pointer is null.\n";
+        std::cerr << "Mesh::submit: shader is NULL\n";
         return;
     }
-    shader->use();
 
-    // Directional light properties.
-    if (!sl->dir)
-    {
-        std::cerr << "Room::draw: SceneLighting->DirectionalLight pointer is null.\n";
+    if (pass == RenderPass::SHADOW && !material_library.get(material).casts_shadows())
         return;
-    }
-
-    shader->set_vec3("dir_light.direction", sl->dir->direction);
-
-    shader->set_vec3("dir_light.ambient", sl->dir->ambient);
-    shader->set_vec3("dir_light.diffuse", sl->dir->diffuse);
-    shader->set_vec3("dir_light.specular", sl->dir->specular);
-
-    // Point light properties.
-    for (std::size_t i = 0; i < sl->points.size(); i++)
-    {
-        std::string attr_prefix{"point_lights[" + std::to_string(i) + "]."};
-
-        if (!sl->points[i])
-        {
-            std::cerr << "Room::draw: SceneLighting->PointLight pointer is null.\n";
-            return;
-        }
-
-        shader->set_vec3(attr_prefix + "position", sl->points[i]->position);
-        shader->set_vec3(attr_prefix + "ambient", sl->points[i]->ambient);
-        shader->set_vec3(attr_prefix + "diffuse", sl->points[i]->color * sl->points[i]->diffuse);
-        shader->set_vec3(attr_prefix + "specular", sl->points[i]->color * sl->points[i]->specular);
-        shader->set_float(attr_prefix + "constant", sl->points[i]->constant);
-        shader->set_float(attr_prefix + "linear", sl->points[i]->linear);
-        shader->set_float(attr_prefix + "quadratic", sl->points[i]->quadratic);
-    }
 
-    // Spotlight properties.
-    if (!sl->spot)
-    {
-        std::cerr << "Room::draw: SceneLighting pointer is null.\n";
+    if (!queue.is_visible(pass, bounding_box, bounding_sphere, model))
         return;
-    }
-
-    shader->set_vec3("spotlight.position", sl->spot->position);
-    shader->set_vec3("spotlight.direction", sl->spot->direction);
 
-    shader->set_float("spotlight.inner_cutoff", glm::cos(glm::radians(sl->spot->inner_cutoff)));
-    shader->set_float("spotlight.outer_cutoff", glm::cos(glm::radians(sl->spot->outer_cutoff)));
-
-    shader->set_vec3("spotlight.ambient", sl->spot->ambient);
-    shader->set_vec3("spotlight.diffuse", sl->spot->diffuse);
-    shader->set_vec3("spotlight.specular", sl->spot->specular);
+    DrawItem item;
+    item.shader = shader;
+    item.vao = vao;
+    item.indexed = true;
+    item.first = first_index;
+    item.count = indices.size();
+    item.base_vertex = base_vertex;
+    item.model = model;
+    add_material(item);
+
+    queue.submit(pass, item);
+}
 
-    shader->set_float("spotlight.constant", sl->spot->constant);
-    shader->set_float("spotlight.linear", sl->spot->linear);
-    shader->set_float("spotlight.quadratic", sl->spot->quadratic);
+void Mesh::add_material(DrawItem& item) const
+{
+    item.material = material;
 
-    // // Material properties.
-    // shader->set_float("material.shininess", 32.0f);
+    if (depth_map_set)
+        item.add_texture(SHADOW_MAP_TEXTURE_UNIT, depth_map);
+}
 
-    // Set textures.
-    unsigned int diffuse_num = 1;
-    unsigned int specular_num = 1;
+void Mesh::set_depth_map(unsigned int texture_id)
+{
+    depth_map = texture_id;
+    depth_map_set = true;
+}
 
-    std::size_t i = 0;
-    for (i = 0; i < textures.size(); i++)
-    {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+const std::vector<Vertex>& Mesh::get_vertices() const
+{
+    return vertices;
+}
 
-        std::string num;
-        std::string name = textures[i].type;
-        if (name == "texture_diffuse")
-            num = std::to_string(diffuse_num++);
-        else if (name == "texture_specular")
-            num = std::to_string(specular_num++);
+const std::vector<unsigned int>& Mesh::get_indices() const
+{
+    return indices;
+}
 
-        shader->set_int("material." + name + num, i);
-    }
+MaterialId Mesh::get_material() const
+{
+    return material;
+}
 
-    if (depth_map_set)
-    {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, depth_map);
-        shader->set_int("shadow_map", i);
-    }
+const BoundingBox& Mesh::get_bounding_box() const
+{
+    return bounding_box;
+}
 
-    // Draw mesh.
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+const BoundingSphere& Mesh::get_bounding_sphere() const
+{
+    return bounding_sphere;
 }
 
-void Mesh::set_depth_map(unsigned int texture_id)
+void Mesh::compute_bounds()
 {
-    depth_map = texture_id;
-    depth_map_set = true;
+    for (const auto& vertex : vertices)
+        bounding_box.add(vertex.position);
+
+    // Centered on the box, reaching the furthest vertex rather than the
+    // box's corners.
+    bounding_sphere.center = bounding_box.center();
+    bounding_sphere.radius = 0.0f;
+    for (const auto& vertex : vertices)
+    {
+        bounding_sphere.radius = std::max(bounding_sphere.radius,
+            glm::length(vertex.position - bounding_sphere.center));
+    }
 }
 
 #endif /* MESH_HPP */
@@ -3,7 +3,9 @@
 
 #include <filesystem>
 #include <iostream>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <assimp/Importer.hpp>
@@ -13,8 +15,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "lights.hpp"
+#include "bounds.hpp"
 #include "mesh.hpp"
+#include "render_queue.hpp"
 #include "shader.hpp"
 #include "utility.hpp"
 
@@ -36,22 +39,32 @@ class Model
 {
 public:
     Model(std::filesystem::path path_,
-        bool flip_model_textures_,
-        SceneLighting* scene_lighting_) :
+        bool flip_model_textures_) :
             path(path_),
-            flip_model_textures(flip_model_textures_),
-            sl(scene_lighting_)
+            flip_model_textures(flip_model_textures_)
     {
     }
 
     bool init();
     void deinit();
-    void draw(Shader* shader);
+
+    // Meshes outside the frustum of the pass, if the queue has one, are
+    // skipped.
+    void submit(RenderQueue& queue,
+        RenderPass pass,
+        Shader* shader,
+        const glm::mat4& model) const;
+
+    // Draw meshes that share a material with one call, the default, or issue
+    // one call per mesh.
+    void set_multi_draw(bool enabled);
 
     void set_depth_map(unsigned int);
-private:
-    SceneLighting* sl;
 
+    // Bounding sphere of every vertex, in model space.
+    glm::vec3 get_bounding_center() const;
+    float get_bounding_radius() const;
+private:
     std::vector<Mesh> meshes;
     std::filesystem::path path;
     std::filesystem::path directory;
@@ -63,30 +76,127 @@ private:
     Mesh process_mesh(aiMesh*, const aiScene*);
     std::vector<Texture> load_material_textures(aiMaterial*,
         aiTextureType,
-        std::string);
+        TextureSlot);
 
     unsigned int depth_map;
     bool depth_map_set = false;
+
+    // Meshes sharing a material, drawn as ranges of the shared buffers
+    // below. `draw` holds one range per mesh, in the order of
+    // `mesh_indices`.
+    struct DrawBatch
+    {
+        MaterialId material;
+        std::vector<std::size_t> mesh_indices;
+        MultiDraw draw;
+    };
+
+    bool multi_draw = true;
+    std::vector<DrawBatch> batches;
+
+    // Every mesh's vertices and indices packed end to end, plus the draw
+    // commands of every batch when multi-draw indirect is supported. Meshes
+    // draw ranges of these whether batched or not.
+    unsigned int vao = 0;
+    unsigned int vbo = 0;
+    unsigned int ebo = 0;
+    unsigned int indirect_buffer = 0;
+
+    void init_buffers();
+
+    BoundingBox bounds;
 };
 
 bool Model::init()
 {
-    return load_model();
+    if (!load_model())
+        return false;
+
+    init_buffers();
+    return true;
 }
 
 void Model::deinit()
 {
-    for (auto& mesh : meshes)
-        mesh.deinit();
+    gl_state.forget_vertex_array(vao);
+    gl_state.forget_buffer(vbo);
+    gl_state.forget_buffer(ebo);
+    gl_state.forget_buffer(indirect_buffer);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    glDeleteBuffers(1, &indirect_buffer);
+    batches.clear();
 }
 
-void Model::draw(Shader* shader)
+void Model::submit(RenderQueue& queue,
+    RenderPass pass,
+    Shader* shader,
+    const glm::mat4& model) const
 {
     if (!shader)
-        std::cerr << "Model::draw: shader is NULL\n";
+    {
+        std::cerr << "Model::submit: shader is NULL\n";
+        return;
+    }
 
-    for (auto& mesh : meshes)
-        mesh.draw(shader);
+    if (!multi_draw)
+    {
+        for (const auto& mesh : meshes)
+            mesh.submit(queue, pass, shader, model);
+        return;
+    }
+
+    for (const auto& batch : batches)
+    {
+        if (pass == RenderPass::SHADOW && !material_library.get(batch.material).casts_shadows())
+            continue;
+
+        // Gather the ranges of visible meshes. A batch left whole keeps its
+        // indirect commands; a partial one is drawn from the CPU arrays.
+        MultiDraw visible;
+        for (std::size_t i = 0; i < batch.mesh_indices.size(); i++)
+        {
+            const Mesh& mesh = meshes[batch.mesh_indices[i]];
+            if (!queue.is_visible(pass, mesh.get_bounding_box(), mesh.get_bounding_sphere(), model))
+                continue;
+
+            visible.counts.push_back(batch.draw.counts[i]);
+            visible.offsets.push_back(batch.draw.offsets[i]);
+            visible.base_vertices.push_back(batch.draw.base_vertices[i]);
+        }
+
+        if (visible.size() == 0)
+            continue;
+
+        DrawItem item;
+        item.shader = shader;
+        item.vao = vao;
+        item.indexed = true;
+        item.model = model;
+        if (visible.size() == batch.draw.size())
+            item.multi_draw = &batch.draw;
+        else
+            item.multi_draw = queue.store_multi_draw(std::move(visible));
+        meshes[batch.mesh_indices.front()].add_material(item);
+
+        queue.submit(pass, item);
+    }
+}
+
+void Model::set_multi_draw(bool enabled)
+{
+    multi_draw = enabled;
+}
+
+glm::vec3 Model::get_bounding_center() const
+{
+    return bounds.center();
+}
+
+float Model::get_bounding_radius() const
+{
+    return glm::length(bounds.max - bounds.min) * 0.5f;
 }
 
 bool Model::load_model()
@@ -125,9 +235,7 @@ void Model::process_node(aiNode* node, const aiScene* scene)
     for (std::size_t i = 0; i < node->mNumMeshes; i++)
     {
         aiMesh* assimp_mesh = scene->mMeshes[node->mMeshes[i]];
-        Mesh my_mesh = process_mesh(assimp_mesh, scene);
-        my_mesh.init();
-        meshes.push_back(my_mesh);
+        meshes.push_back(process_mesh(assimp_mesh, scene));
     }
 
     // Process child nodes recursively.
@@ -135,11 +243,80 @@ void Model::process_node(aiNode* node, const aiScene* scene)
         process_node(node->mChildren[i], scene);
 }
 
+void Model::init_buffers()
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<std::vector<DrawElementsIndirectCommand>> commands;
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+
+    // Group meshes by material.
+    std::map<MaterialId, std::size_t> batch_indices;
+
+    for (std::size_t i = 0; i < meshes.size(); i++)
+    {
+        MaterialId material = meshes[i].get_material();
+        auto [it, inserted] = batch_indices.emplace(material, batches.size());
+        if (inserted)
+        {
+            batches.push_back({material, {}, MultiDraw{}});
+            commands.emplace_back();
+        }
+
+        // Indices stay relative to the mesh's first vertex.
+        const auto& mesh_vertices = meshes[i].get_vertices();
+        const auto& mesh_indices = meshes[i].get_indices();
+        DrawElementsIndirectCommand command{};
+        command.count = mesh_indices.size();
+        command.instance_count = 1;
+        command.first_index = indices.size();
+        command.base_vertex = vertices.size();
+
+        meshes[i].set_range(vao, command.first_index, command.base_vertex);
+        batches[it->second].mesh_indices.push_back(i);
+        batches[it->second].draw.add(command);
+        commands[it->second].push_back(command);
+
+        vertices.insert(vertices.end(), mesh_vertices.begin(), mesh_vertices.end());
+        indices.insert(indices.end(), mesh_indices.begin(), mesh_indices.end());
+    }
+
+    gl_state.bind_vertex_array(vao);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, vbo);
+    immutable_buffer_data(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data());
+    gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    immutable_buffer_data(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data());
+    set_vertex_attributes();
+    gl_state.bind_vertex_array(0);
+
+    // Lay the batches' commands out back to back in one buffer.
+    if (gl_ext.has_multi_draw_indirect)
+    {
+        std::vector<DrawElementsIndirectCommand> all_commands;
+        for (std::size_t i = 0; i < batches.size(); i++)
+        {
+            batches[i].draw.indirect_offset = sizeof(DrawElementsIndirectCommand) * all_commands.size();
+            all_commands.insert(all_commands.end(), commands[i].begin(), commands[i].end());
+        }
+
+        glGenBuffers(1, &indirect_buffer);
+        named_buffer_data(GL_DRAW_INDIRECT_BUFFER, indirect_buffer,
+            sizeof(DrawElementsIndirectCommand) * all_commands.size(), all_commands.data(),
+            GL_STATIC_DRAW);
+
+        for (auto& batch : batches)
+            batch.draw.indirect_buffer = indirect_buffer;
+    }
+}
+
 Mesh Model::process_mesh(aiMesh* mesh, const aiScene* scene)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    Material my_material;
 
     // Process vertices.
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -150,6 +327,7 @@ Mesh Model::process_mesh(aiMesh* mesh, const aiScene* scene)
         vertex.position.x = mesh->mVertices[i].x;
         vertex.position.y = mesh->mVertices[i].y;
         vertex.position.z = mesh->mVertices[i].z;
+        bounds.add(vertex.position);
 
         // Vertex normals.
         vertex.normal.x = mesh->mNormals[i].x;
@@ -178,27 +356,29 @@ Mesh Model::process_mesh(aiMesh* mesh, const aiScene* scene)
             indices.push_back(face.mIndices[j]);
     }
 
-    // Process material.
+    // Process material. Shaders sample one texture per slot, so only the
+    // first of each type is used.
     if (mesh->mMaterialIndex >= 0)
     {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
         std::vector<Texture> diffuse_maps = load_material_textures(material,
-            aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(std::end(textures), std::begin(diffuse_maps),
-            std::end(diffuse_maps));
+            aiTextureType_DIFFUSE, TextureSlot::DIFFUSE);
+        if (!diffuse_maps.empty())
+            my_material.set_texture(TextureSlot::DIFFUSE, diffuse_maps.front().id);
 
         std::vector<Texture> specular_maps = load_material_textures(material,
-            aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(std::end(textures), std::begin(specular_maps),
-            std::end(specular_maps));
+            aiTextureType_SPECULAR, TextureSlot::SPECULAR);
+        if (!specular_maps.empty())
+            my_material.set_texture(TextureSlot::SPECULAR, specular_maps.front().id);
     }
 
-    return Mesh(vertices, indices, textures, sl);
+    // Meshes with the same textures share one material.
+    return Mesh(vertices, indices, material_library.add(my_material));
 }
 
 std::vector<Texture> Model::load_material_textures(aiMaterial* material,
-    aiTextureType type, std::string type_name)
+    aiTextureType type, TextureSlot slot)
 {
     std::vector<Texture> textures;
     for (std::size_t i = 0; i < material->GetTextureCount(type); i++)
@@ -226,7 +406,7 @@ std::vector<Texture> Model::load_material_textures(aiMaterial* material,
 
             std::cout << "Loading texture from " << texture_path << '\n';
             texture.id = load_texture_from_file(texture_path);
-            texture.type = type_name;
+            texture.slot = slot;
             texture.path = str.C_Str();
             textures.push_back(texture);
             loaded_textures.push_back(texture);
@@ -30,8 +30,8 @@ void Quad::init()
 {
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    gl_state.bind_vertex_array(vao);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(float) * quad_vertices.size(), quad_vertices.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -49,20 +49,14 @@ void Quad::draw(Shader* shader)
 
     shader->use();
 
-    // Bind vertex buffers.
-    glBindVertexArray(vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * quad_vertices.size(), quad_vertices.data(), GL_STATIC_DRAW);
+    // Bind vertex buffers. The vertex data never changes after init().
+    gl_state.bind_vertex_array(vao);
 
     // Bind textures.
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, depth_map);
-    shader->set_int("depth_map", 0);
+    gl_state.bind_texture(DEPTH_MAP_TEXTURE_UNIT, GL_TEXTURE_2D, depth_map);
 
     // Render.
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
 #endif /* QUAD_HPP */
@@ -0,0 +1,413 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bounds.hpp"
+#include "material.hpp"
+#include "shader.hpp"
+
+// Passes are drawn separately, each into its own target.
+enum class RenderPass : unsigned int
+{
+    SHADOW,
+    DEPTH,  // Camera depth only, drawn before OPAQUE.
+    OPAQUE,
+    UNLIT,  // Drawn after OPAQUE with the default depth state, outside DEPTH.
+};
+
+constexpr std::size_t NUM_RENDER_PASSES = 4;
+
+// Texture units a draw binds, beyond which textures are dropped.
+constexpr std::size_t MAX_DRAW_TEXTURES = 4;
+
+// Layout of a command in a GL_DRAW_INDIRECT_BUFFER for indexed draws.
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+/*
+ * Several index ranges of one vertex array drawn with a single call. With
+ * multi-draw indirect the commands are read from `indirect_buffer` starting
+ * at `indirect_offset`; otherwise the same ranges, mirrored in the arrays
+ * below, go to glMultiDrawElementsBaseVertex.
+ */
+struct MultiDraw
+{
+    unsigned int indirect_buffer = 0;
+    GLintptr indirect_offset = 0;
+
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> base_vertices;
+
+    // Append an indirect command and its fallback range.
+    void add(const DrawElementsIndirectCommand& command);
+
+    GLsizei size() const;
+};
+
+void MultiDraw::add(const DrawElementsIndirectCommand& command)
+{
+    counts.push_back(command.count);
+    offsets.push_back((void*)(command.first_index * sizeof(unsigned int)));
+    base_vertices.push_back(command.base_vertex);
+}
+
+GLsizei MultiDraw::size() const
+{
+    return counts.size();
+}
+
+// Everything needed to issue one draw call. The model matrix and optional
+// color are set on the program per item, and the material whenever it differs
+// from the previous item's; other uniforms are per program and set by the
+// caller before executing a pass.
+struct DrawItem
+{
+    Shader* shader = nullptr;
+    unsigned int vao = 0;
+
+    GLenum mode = GL_TRIANGLES;
+    bool indexed = false;
+    GLint first = 0;
+    GLsizei count = 0;
+
+    // Added to every index, so meshes packed into one buffer can keep
+    // indices relative to their own first vertex.
+    GLint base_vertex = 0;
+
+    // More than one draws instanced, with per-instance attributes taken from
+    // the vertex array.
+    GLsizei instance_count = 1;
+
+    // Set to draw these ranges of `vao` instead of `first` and `count`. Must
+    // outlive the pass.
+    const MultiDraw* multi_draw = nullptr;
+
+    glm::mat4 model = glm::mat4(1.0f);
+
+    // Index into material_library, whose textures are bound alongside the
+    // ones below.
+    MaterialId material = NO_MATERIAL;
+
+    bool has_color = false;
+    glm::vec3 color = glm::vec3(0.0f);
+
+    std::array<std::pair<unsigned int, unsigned int>, MAX_DRAW_TEXTURES> textures;
+    std::size_t num_textures = 0;
+
+    // Bind `texture` to `unit` for this draw.
+    void add_texture(unsigned int unit, unsigned int texture);
+};
+
+void DrawItem::add_texture(unsigned int unit, unsigned int texture)
+{
+    if (num_textures == textures.size())
+    {
+        std::cerr << "DrawItem::add_texture: more than " << MAX_DRAW_TEXTURES
+            << " textures\n";
+        return;
+    }
+
+    textures[num_textures++] = {unit, texture};
+}
+
+// Bounded objects tested against a pass's frustum.
+struct CullStats
+{
+    std::size_t visible = 0;
+    std::size_t culled = 0;
+};
+
+/*
+ * Draw items collected per pass, then sorted and drawn in one go so state
+ * changes happen as rarely as possible. Each item gets a 64-bit key, from the
+ * most significant bits down:
+ *
+ *   pass (4) | program (12) | material and textures (16) | vertex array (16) | depth (16)
+ *
+ * Items sharing a program, material, textures and vertex array are therefore
+ * drawn back to back, nearest first.
+ *
+ * A pass given a frustum lets callers reject bounded objects before they
+ * submit anything for them, see is_visible().
+ *
+ * Submitting only touches CPU memory, so parts of a frame can be recorded on
+ * worker threads, each into its own queue, then appended to the queue the GL
+ * thread executes.
+ */
+class RenderQueue
+{
+public:
+    // Depth is the distance from `position` to each item's origin, scaled by
+    // `max_depth`. Set before submitting to the pass.
+    void set_view(RenderPass pass, const glm::vec3& position, float max_depth);
+
+    // Cull the pass against the frustum of `view_projection`. Set before
+    // submitting to the pass.
+    void set_frustum(RenderPass pass, const glm::mat4& view_projection);
+
+    // Whether a volume, given in model space, may be seen in the pass once
+    // transformed by `model`. The sphere is tried first as it is cheaper.
+    // Always true for passes without a frustum. Counted in get_cull_stats().
+    bool is_visible(RenderPass pass,
+        const BoundingBox& box,
+        const BoundingSphere& sphere,
+        const glm::mat4& model);
+
+    // Keep `draw` alive until the queue is cleared, for items built per
+    // frame.
+    const MultiDraw* store_multi_draw(MultiDraw draw);
+
+    void submit(RenderPass pass, const DrawItem& item);
+
+    // Sort and draw everything submitted to the pass.
+    void execute(RenderPass pass);
+
+    // Drop all items, ready for the next frame.
+    void clear();
+
+    // Clear `list` and give it this queue's views, ready to record part of
+    // the frame for append().
+    void prepare_list(RenderQueue& list) const;
+
+    // Move every item of `list` to the end of this queue, leaving it empty.
+    void append(RenderQueue& list);
+
+    std::size_t size(RenderPass pass) const;
+
+    CullStats get_cull_stats(RenderPass pass) const;
+private:
+    struct View
+    {
+        glm::vec3 position = glm::vec3(0.0f);
+        float max_depth = 100.0f;
+
+        bool has_frustum = false;
+        Frustum frustum;
+    };
+
+    std::array<View, NUM_RENDER_PASSES> views;
+    std::array<std::vector<DrawItem>, NUM_RENDER_PASSES> items;
+    std::array<CullStats, NUM_RENDER_PASSES> cull_stats;
+
+    // Held by pointer so items keep pointing at them across append().
+    std::vector<std::unique_ptr<MultiDraw>> multi_draws;
+
+    // Sort key and index into `items` of each submitted item.
+    std::array<std::vector<std::pair<std::uint64_t, std::uint32_t>>, NUM_RENDER_PASSES> keys;
+
+    std::uint64_t sort_key(RenderPass pass, const DrawItem& item) const;
+};
+
+void RenderQueue::set_view(RenderPass pass, const glm::vec3& position, float max_depth)
+{
+    views[(std::size_t)pass].position = position;
+    views[(std::size_t)pass].max_depth = max_depth;
+}
+
+void RenderQueue::set_frustum(RenderPass pass, const glm::mat4& view_projection)
+{
+    views[(std::size_t)pass].has_frustum = true;
+    views[(std::size_t)pass].frustum = Frustum(view_projection);
+}
+
+bool RenderQueue::is_visible(RenderPass pass,
+    const BoundingBox& box,
+    const BoundingSphere& sphere,
+    const glm::mat4& model)
+{
+    const View& view = views[(std::size_t)pass];
+    CullStats& stats = cull_stats[(std::size_t)pass];
+
+    bool visible = !view.has_frustum ||
+        (view.frustum.intersects(sphere.transformed(model)) &&
+            view.frustum.intersects(box.transformed(model)));
+
+    if (visible)
+        stats.visible++;
+    else
+        stats.culled++;
+    return visible;
+}
+
+const MultiDraw* RenderQueue::store_multi_draw(MultiDraw draw)
+{
+    multi_draws.push_back(std::make_unique<MultiDraw>(std::move(draw)));
+    return multi_draws.back().get();
+}
+
+void RenderQueue::submit(RenderPass pass, const DrawItem& item)
+{
+    if (!item.shader)
+    {
+        std::cerr << "RenderQueue::submit: shader is NULL\n";
+        return;
+    }
+
+    auto& pass_items = items[(std::size_t)pass];
+    keys[(std::size_t)pass].emplace_back(sort_key(pass, item), pass_items.size());
+    pass_items.push_back(item);
+}
+
+void RenderQueue::execute(RenderPass pass)
+{
+    auto& pass_items = items[(std::size_t)pass];
+    auto& pass_keys = keys[(std::size_t)pass];
+    std::sort(pass_keys.begin(), pass_keys.end());
+
+    Shader* shader = nullptr;
+    UniformHandle model_handle;
+    UniformHandle color_handle;
+    UniformHandle shininess_handle;
+    MaterialId material = NO_MATERIAL;
+
+    for (const auto& [key, index] : pass_keys)
+    {
+        const DrawItem& item = pass_items[index];
+
+        if (item.shader != shader)
+        {
+            shader = item.shader;
+            shader->use();
+            model_handle = shader->uniform("model");
+            color_handle = shader->uniform("color");
+            shininess_handle = shader->uniform("material.shininess");
+
+            // Uniforms are per program, so the new one needs the material.
+            material = NO_MATERIAL;
+        }
+
+        if (item.material != material)
+        {
+            material = item.material;
+            if (material != NO_MATERIAL)
+                material_library.get(material).apply(*shader, shininess_handle);
+        }
+
+        for (std::size_t i = 0; i < item.num_textures; i++)
+        {
+            const auto& [unit, texture] = item.textures[i];
+            if (shader->uses_texture_unit(unit))
+                gl_state.bind_texture(unit, GL_TEXTURE_2D, texture);
+        }
+
+        shader->set_mat4fv(model_handle, item.model);
+        if (item.has_color)
+            shader->set_vec3(color_handle, item.color);
+
+        gl_state.bind_vertex_array(item.vao);
+        if (item.multi_draw)
+        {
+            const MultiDraw& draw = *item.multi_draw;
+            if (gl_ext.has_multi_draw_indirect && draw.indirect_buffer)
+            {
+                gl_state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, draw.indirect_buffer);
+                gl_ext.MultiDrawElementsIndirect(item.mode, GL_UNSIGNED_INT,
+                    (void*)draw.indirect_offset, draw.size(), 0);
+            }
+            else
+            {
+                glMultiDrawElementsBaseVertex(item.mode, draw.counts.data(), GL_UNSIGNED_INT,
+                    draw.offsets.data(), draw.size(), draw.base_vertices.data());
+            }
+        }
+        else if (item.indexed)
+        {
+            glDrawElementsInstancedBaseVertex(item.mode, item.count, GL_UNSIGNED_INT,
+                (void*)(item.first * sizeof(unsigned int)), item.instance_count,
+                item.base_vertex);
+        }
+        else
+        {
+            glDrawArraysInstanced(item.mode, item.first, item.count, item.instance_count);
+        }
+    }
+}
+
+void RenderQueue::clear()
+{
+    for (auto& pass_items : items)
+        pass_items.clear();
+    for (auto& pass_keys : keys)
+        pass_keys.clear();
+    cull_stats.fill(CullStats{});
+    multi_draws.clear();
+}
+
+void RenderQueue::prepare_list(RenderQueue& list) const
+{
+    list.clear();
+    list.views = views;
+}
+
+void RenderQueue::append(RenderQueue& list)
+{
+    for (std::size_t pass = 0; pass < NUM_RENDER_PASSES; pass++)
+    {
+        auto& pass_items = items[pass];
+        std::uint32_t offset = pass_items.size();
+
+        pass_items.insert(pass_items.end(), list.items[pass].begin(), list.items[pass].end());
+        for (const auto& [key, index] : list.keys[pass])
+            keys[pass].emplace_back(key, offset + index);
+
+        cull_stats[pass].visible += list.cull_stats[pass].visible;
+        cull_stats[pass].culled += list.cull_stats[pass].culled;
+    }
+
+    for (auto& draw : list.multi_draws)
+        multi_draws.push_back(std::move(draw));
+
+    list.clear();
+}
+
+std::size_t RenderQueue::size(RenderPass pass) const
+{
+    return items[(std::size_t)pass].size();
+}
+
+CullStats RenderQueue::get_cull_stats(RenderPass pass) const
+{
+    return cull_stats[(std::size_t)pass];
+}
+
+std::uint64_t RenderQueue::sort_key(RenderPass pass, const DrawItem& item) const
+{
+    // Fold the material and bound textures into one value. Collisions only
+    // cost sorting quality.
+    std::uint64_t texture_set = item.material;
+    for (std::size_t i = 0; i < item.num_textures; i++)
+    {
+        texture_set = texture_set * 31 + item.textures[i].first;
+        texture_set = texture_set * 31 + item.textures[i].second;
+    }
+    texture_set = (texture_set ^ (texture_set >> 16) ^ (texture_set >> 32)) & 0xffff;
+
+    const View& view = views[(std::size_t)pass];
+    float distance = glm::length(glm::vec3(item.model[3]) - view.position);
+    float depth = std::clamp(distance / view.max_depth, 0.0f, 1.0f);
+
+    return ((std::uint64_t)pass & 0xf) << 60 |
+        ((std::uint64_t)item.shader->get_id() & 0xfff) << 48 |
+        texture_set << 32 |
+        ((std::uint64_t)item.vao & 0xffff) << 16 |
+        (std::uint64_t)(depth * 0xffff);
+}
+
+#endif /* RENDER_QUEUE_HPP */
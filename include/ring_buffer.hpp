@@ -0,0 +1,190 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include "gl_extensions.hpp"
+
+/*
+ * Per-frame data written once per frame and read by the GPU during that
+ * frame. With buffer storage, the buffer holds one section per frame in
+ * flight and stays persistently mapped, so a write is a memcpy; a fence per
+ * section stops the CPU overwriting data the GPU has not read yet. Without
+ * it, the buffer holds a single section that is orphaned at the start of
+ * every frame and written with glBufferSubData.
+ */
+class RingBuffer
+{
+public:
+    // Frames the CPU may run ahead of the GPU.
+    static constexpr std::size_t NUM_FRAMES = 3;
+
+    // `frame_size` bytes can be written per frame.
+    void init(GLenum target, std::size_t frame_size);
+    void deinit();
+
+    // Start writing the next section, waiting for the GPU to finish reading
+    // it if needed.
+    void begin_frame();
+
+    // Copy `size` bytes into the current section. Returns their offset in the
+    // buffer, or -1 if the section is full.
+    GLintptr write(const void* data, std::size_t size);
+
+    // Write `size` bytes and bind them to the indexed binding point.
+    bool bind(unsigned int index, const void* data, std::size_t size);
+
+    // Fence the section written this frame.
+    void end_frame();
+
+    unsigned int get_id() const;
+private:
+    GLenum target = GL_UNIFORM_BUFFER;
+    unsigned int buffer = 0;
+    std::size_t frame_size = 0;
+    std::size_t alignment = 1;
+
+    std::size_t frame = 0;
+    std::size_t offset = 0;
+
+    // Persistently mapped sections, or nullptr when orphaning.
+    unsigned char* mapped = nullptr;
+    std::array<GLsync, NUM_FRAMES> fences{};
+};
+
+void RingBuffer::init(GLenum target_, std::size_t frame_size_)
+{
+    target = target_;
+
+    // Bound ranges must start on the offset alignment of the target.
+    int offset_alignment = 16;
+    if (target == GL_UNIFORM_BUFFER)
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+    alignment = offset_alignment;
+    frame_size = (frame_size_ + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &buffer);
+    gl_state.bind_buffer(target, buffer);
+
+    if (gl_ext.has_buffer_storage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl_ext.BufferStorage(target, frame_size * NUM_FRAMES, nullptr, flags);
+        mapped = (unsigned char*)glMapBufferRange(target, 0, frame_size * NUM_FRAMES, flags);
+
+        if (!mapped)
+        {
+            // Storage is immutable, so start over with a mutable buffer.
+            std::cerr << "RingBuffer::init: persistent mapping failed, orphaning instead\n";
+            gl_state.forget_buffer(buffer);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+        }
+    }
+
+    if (!mapped)
+        named_buffer_data(target, buffer, frame_size, nullptr, GL_STREAM_DRAW);
+
+    frame = 0;
+    offset = 0;
+}
+
+void RingBuffer::deinit()
+{
+    for (auto& fence : fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (mapped)
+    {
+        gl_state.bind_buffer(target, buffer);
+        glUnmapBuffer(target);
+        mapped = nullptr;
+    }
+
+    gl_state.forget_buffer(buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void RingBuffer::begin_frame()
+{
+    offset = 0;
+
+    if (!mapped)
+    {
+        // Let the driver hand out fresh storage while draws from the last
+        // frame still read the old.
+        named_buffer_data(target, buffer, frame_size, nullptr, GL_STREAM_DRAW);
+        return;
+    }
+
+    frame = (frame + 1) % NUM_FRAMES;
+
+    GLsync& fence = fences[frame];
+    if (!fence)
+        return;
+
+    // Flush once so the fence is guaranteed to signal, then wait.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED)
+        flags = 0;
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+GLintptr RingBuffer::write(const void* data, std::size_t size)
+{
+    if (offset + size > frame_size)
+    {
+        std::cerr << "RingBuffer::write: " << size << " bytes do not fit in the "
+            << frame_size - offset << " left this frame\n";
+        return -1;
+    }
+
+    GLintptr result = offset;
+    if (mapped)
+    {
+        result += frame * frame_size;
+        std::memcpy(mapped + result, data, size);
+    }
+    else
+    {
+        named_buffer_sub_data(target, buffer, result, size, data);
+    }
+
+    offset = (offset + size + alignment - 1) / alignment * alignment;
+    return result;
+}
+
+bool RingBuffer::bind(unsigned int index, const void* data, std::size_t size)
+{
+    GLintptr buffer_offset = write(data, size);
+    if (buffer_offset < 0)
+        return false;
+
+    gl_state.bind_buffer_range(target, index, buffer, buffer_offset, size);
+    return true;
+}
+
+void RingBuffer::end_frame()
+{
+    if (mapped)
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+unsigned int RingBuffer::get_id() const
+{
+    return buffer;
+}
+
+#endif /* RING_BUFFER_HPP */
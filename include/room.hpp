@@ -3,10 +3,12 @@
 
 #include <cassert>
 #include <filesystem>
+#include <map>
 #include <string>
 #include <vector>
 
-#include "lights.hpp"
+#include "material.hpp"
+#include "render_queue.hpp"
 #include "shader.hpp"
 #include "shapes.hpp"
 #include "utility.hpp"
@@ -67,7 +69,6 @@ public:
         std::filesystem::path ceiling_specular_texture_path_,
         std::filesystem::path wall_diffuse_texture_path_,
         std::filesystem::path wall_specular_texture_path_,
-        SceneLighting* scene_lighting_,
         float scale_factor_) :
             floor_diffuse_texture_path(floor_diffuse_texture_path_),
             floor_specular_texture_path(floor_specular_texture_path_),
@@ -75,14 +76,13 @@ public:
             ceiling_specular_texture_path(ceiling_specular_texture_path_),
             wall_diffuse_texture_path(wall_diffuse_texture_path_),
             wall_specular_texture_path(wall_specular_texture_path_),
-            sl(scene_lighting_),
             scale_factor(scale_factor_)
     {
     }
 
     void init();
     void deinit();
-    void draw(Shader* shader);
+    void submit(RenderQueue& queue, RenderPass pass, Shader* shader) const;
 
     void set_depth_map(unsigned int);
 private:
@@ -93,38 +93,118 @@ private:
     std::filesystem::path wall_diffuse_texture_path;
     std::filesystem::path wall_specular_texture_path;
 
-    unsigned int floor_diffuse_texture;
-    unsigned int floor_specular_texture;
-    unsigned int ceiling_diffuse_texture;
-    unsigned int ceiling_specular_texture;
-    unsigned int wall_diffuse_texture;
-    unsigned int wall_specular_texture;
+    // Every surface baked into world space in one buffer. Surfaces sharing
+    // a material are adjacent, so each group is drawn with one call.
+    struct SurfaceGroup
+    {
+        GLint first;
+        GLsizei count;
+        MaterialId material;
+    };
 
     unsigned int vao;
     unsigned int vbo;
     unsigned int ebo;
-
-    SceneLighting* sl;
+    std::vector<SurfaceGroup> groups;
 
     float scale_factor;
 
+    // Append a quad transformed by `model` to the baked vertices and indices.
+    void bake_surface(std::vector<float>& vertices,
+        std::vector<unsigned int>& indices,
+        const std::vector<float>& quad,
+        const glm::mat4& model) const;
+
     unsigned int depth_map;
     bool depth_map_set = false;
 };
 
 void Room::init()
 {
+    // Load each texture once, even when surfaces share it.
+    std::map<std::filesystem::path, unsigned int> textures;
+    auto load_texture = [&textures](const std::filesystem::path& path) {
+        auto [it, inserted] = textures.emplace(path, 0);
+        if (inserted)
+            it->second = load_texture_from_file(path);
+        return it->second;
+    };
+
+    // Load materials. Surfaces with the same textures share a material.
+    Material floor_material;
+    floor_material.set_texture(TextureSlot::DIFFUSE, load_texture(floor_diffuse_texture_path));
+    floor_material.set_texture(TextureSlot::SPECULAR, load_texture(floor_specular_texture_path));
+
+    Material ceiling_material;
+    ceiling_material.set_texture(TextureSlot::DIFFUSE, load_texture(ceiling_diffuse_texture_path));
+    ceiling_material.set_texture(TextureSlot::SPECULAR, load_texture(ceiling_specular_texture_path));
+
+    Material wall_material;
+    wall_material.set_texture(TextureSlot::DIFFUSE, load_texture(wall_diffuse_texture_path));
+    wall_material.set_texture(TextureSlot::SPECULAR, load_texture(wall_specular_texture_path));
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    glm::mat4 model = glm::mat4(1.0f);
+
+    /*
+     * Floor.
+     */
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, floor_translation_vec);
+    model = glm::rotate(model, glm::radians(floor_rotation_angle), floor_rotation_axis);
+    model = glm::scale(model, glm::vec3(scale_factor));
+    bake_surface(vertices, indices, floor_vertices, model);
+    groups.push_back({0, (GLsizei)indices.size(), material_library.add(floor_material)});
+
+    /*
+     * Ceiling.
+     */
+    GLint first = indices.size();
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, ceiling_translation_vec);
+    model = glm::rotate(model, glm::radians(ceiling_rotation_angle), ceiling_rotation_axis);
+    model = glm::scale(model, glm::vec3(scale_factor));
+    bake_surface(vertices, indices, floor_vertices, model);
+    groups.push_back({first, (GLsizei)(indices.size() - first),
+        material_library.add(ceiling_material)});
+
+    /*
+     * Walls.
+     */
+    first = indices.size();
+    assert(wall_translation_vecs.size() == wall_rotation_angles.size());
+    assert(wall_translation_vecs.size() == wall_rotation_axes.size());
+    for (std::size_t i = 0; i < wall_translation_vecs.size(); i++)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, wall_translation_vecs[i]);
+        model = glm::rotate(model, glm::radians(wall_rotation_angles[i]), wall_rotation_axes[i]);
+
+        // Add rotation for one wall.
+        if (i == 2)
+            model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        model = glm::scale(model, glm::vec3(scale_factor));
+        bake_surface(vertices, indices, wall_vertices, model);
+    }
+    groups.push_back({first, (GLsizei)(indices.size() - first),
+        material_library.add(wall_material)});
+
+    /*
+     * Upload once. Nothing is written to the buffers after this.
+     */
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
     glGenBuffers(1, &ebo);
 
-    glBindVertexArray(vao);
+    gl_state.bind_vertex_array(vao);
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * floor_vertices.size(), floor_vertices.data(), GL_STATIC_DRAW);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, vbo);
+    immutable_buffer_data(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data());
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * square_indices.size(), square_indices.data(), GL_STATIC_DRAW);
+    gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    immutable_buffer_data(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data());
 
     // Vertex positions.
     glEnableVertexAttribArray(0);
@@ -136,215 +216,70 @@ void Room::init()
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 
-    glBindVertexArray(0);
-
-    // Load textures.
-    floor_diffuse_texture = load_texture_from_file(floor_diffuse_texture_path);
-    floor_specular_texture = load_texture_from_file(floor_specular_texture_path);
-    ceiling_diffuse_texture = load_texture_from_file(ceiling_diffuse_texture_path);
-    ceiling_specular_texture = load_texture_from_file(ceiling_specular_texture_path);
-    wall_diffuse_texture = load_texture_from_file(wall_diffuse_texture_path);
-    wall_specular_texture = load_texture_from_file(wall_specular_texture_path);
+    gl_state.bind_vertex_array(0);
 }
 
 void Room::deinit()
 {
+    gl_state.forget_vertex_array(vao);
+    gl_state.forget_buffer(vbo);
+    gl_state.forget_buffer(ebo);
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(1, &vbo);
     glDeleteBuffers(1, &ebo);
+    groups.clear();
 }
 
-void Room::draw(Shader* shader)
+void Room::bake_surface(std::vector<float>& vertices,
+    std::vector<unsigned int>& indices,
+    const std::vector<float>& quad,
+    const glm::mat4& model) const
 {
-    if (!shader)
-        std::cerr << "Room::draw: shader is NULL\n";
-
-    shader->use();
-
-    // Set shader textures.
-    shader->set_int("material.texture_diffuse1", 0);
-    shader->set_int("material.texture_specular1", 1);
-    shader->set_int("shadow_map", 2);
+    glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    unsigned int base_vertex = vertices.size() / 8;
 
-    // Set depth map for room if possible.
-    if (depth_map_set)
+    for (std::size_t i = 0; i + 8 <= quad.size(); i += 8)
     {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, depth_map);
-    }
+        glm::vec3 position = glm::vec3(model * glm::vec4(quad[i], quad[i + 1], quad[i + 2], 1.0f));
+        glm::vec3 normal = glm::normalize(normal_matrix * glm::vec3(quad[i + 3], quad[i + 4], quad[i + 5]));
 
-    /*
-     * Set shader attributes.
-     */
-    if (sl)
-    {
-        // Directional light properties.
-        if (sl->dir)
-        {
-            shader->set_vec3("dir_light.direction", sl->dir->direction);
-
-            shader->set_vec3("dir_light.ambient", sl->dir->ambient);
-            shader->set_vec3("dir_light.diffuse", sl->dir->diffuse);
-            shader->set_vec3("dir_light.specular", sl->dir->specular);
-        }
-        else
-        {
-            std::cerr << "Room::draw: SceneLighting->DirectionalLight pointer is null.\n";
-        }
-
-        // Point light properties.
-        for (std::size_t i = 0; i < sl->points.size(); i++)
-        {
-            std::string attr_prefix{"point_lights[" + std::to_string(i) + "]."};
-
-            if (sl->points[i])
-            {
-                shader->set_vec3(attr_prefix + "position", sl->points[i]->position);
-                shader->set_vec3(attr_prefix + "ambient", sl->points[i]->ambient);
-                shader->set_vec3(attr_prefix + "diffuse", sl->points[i]->color * sl->points[i]->diffuse);
-                shader->set_vec3(attr_prefix + "specular", sl->points[i]->color * sl->points[i]->specular);
-                shader->set_float(attr_prefix + "constant", sl->points[i]->constant);
-                shader->set_float(attr_prefix + "linear", sl->points[i]->linear);
-                shader->set_float(attr_prefix + "quadratic", sl->points[i]->quadratic);
-
-            }
-            else
-            {
-                std::cerr << "Room::draw: SceneLighting->PointLight pointer is null.\n";
-            }
-        }
-
-        // Spotlight properties.
-        if (sl->spot)
-        {
-            shader->set_vec3("spotlight.position", sl->spot->position);
-            shader->set_vec3("spotlight.direction", sl->spot->direction);
-
-            shader->set_float("spotlight.inner_cutoff", glm::cos(glm::radians(sl->spot->inner_cutoff)));
-            shader->set_float("spotlight.outer_cutoff", glm::cos(glm::radians(sl->spot->outer_cutoff)));
-
-            shader->set_vec3("spotlight.ambient", sl->spot->ambient);
-            shader->set_vec3("spotlight.diffuse", sl->spot->diffuse);
-            shader->set_vec3("spotlight.specular", sl->spot->specular);
-
-            shader->set_float("spotlight.constant", sl->spot->constant);
-            shader->set_float("spotlight.linear", sl->spot->linear);
-            shader->set_float("spotlight.quadratic", sl->spot->quadratic);
-        }
-        else
-        {
-            std::cerr << "Room::draw: SceneLighting->Spotlight pointer is null.\n";
-        }
-
-        // Material properties.
-        // shader->set_float("material.shininess", 32.0f);
-    }
-    else
-    {
-        std::cerr << "Room::draw: SceneLighting pointer is null.\n";
+        vertices.insert(vertices.end(), {
+            position.x, position.y, position.z,
+            normal.x, normal.y, normal.z,
+            quad[i + 6], quad[i + 7]});
     }
 
-    /*
-     * Initialize model matrix.
-     */
-    glm::mat4 model = glm::mat4(1.0f);
-
-    /*
-     * Draw floor.
-     */
-    // Bind vertex buffers.
-    glBindVertexArray(vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * floor_vertices.size(), floor_vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * square_indices.size(), square_indices.data(), GL_STATIC_DRAW);
-
-    // Set model matrix.
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, floor_translation_vec);
-    model = glm::rotate(model, glm::radians(floor_rotation_angle), floor_rotation_axis);
-    model = glm::scale(model, glm::vec3(scale_factor));
-    shader->set_mat4fv("model", model);
-
-    // Set textures.
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, floor_diffuse_texture);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, floor_specular_texture);
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glDrawElements(GL_TRIANGLES, square_indices.size(), GL_UNSIGNED_INT, 0);
-
-    /*
-     * Draw ceiling.
-     */
-    // Bind vertex buffers.
-    glBindVertexArray(vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * floor_vertices.size(), floor_vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * square_indices.size(), square_indices.data(), GL_STATIC_DRAW);
-
-    // Set model matrix.
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, ceiling_translation_vec);
-    model = glm::rotate(model, glm::radians(ceiling_rotation_angle), ceiling_rotation_axis);
-    model = glm::scale(model, glm::vec3(scale_factor));
-    shader->set_mat4fv("model", model);
-
-    // Set textures.
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, ceiling_diffuse_texture);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, ceiling_specular_texture);
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glDrawElements(GL_TRIANGLES, square_indices.size(), GL_UNSIGNED_INT, 0);
-
-    /*
-     * Draw walls.
-     */
-    // Bind vertex buffers.
-    glBindVertexArray(vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * wall_vertices.size(), wall_vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * square_indices.size(), square_indices.data(), GL_STATIC_DRAW);
+    for (unsigned int index : square_indices)
+        indices.push_back(base_vertex + index);
+}
 
-    // Set model matrix.
-    assert(wall_translation_vecs.size() == wall_rotation_angles.size());
-    assert(wall_translation_vecs.size() == wall_rotation_axes.size());
-    for (std::size_t i = 0; i < wall_translation_vecs.size(); i++)
+void Room::submit(RenderQueue& queue, RenderPass pass, Shader* shader) const
+{
+    if (!shader)
     {
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, wall_translation_vecs[i]);
-        model = glm::rotate(model, glm::radians(wall_rotation_angles[i]), wall_rotation_axes[i]);
+        std::cerr << "Room::submit: shader is NULL\n";
+        return;
+    }
 
-        // Add rotation for one wall.
-        if (i == 2)
-            model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    // Vertices are already in world space.
+    for (const auto& group : groups)
+    {
+        if (pass == RenderPass::SHADOW && !material_library.get(group.material).casts_shadows())
+            continue;
 
-        model = glm::scale(model, glm::vec3(scale_factor));
-        shader->set_mat4fv("model", model);
+        DrawItem item;
+        item.shader = shader;
+        item.vao = vao;
+        item.indexed = true;
+        item.first = group.first;
+        item.count = group.count;
 
-        // Set textures.
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, wall_diffuse_texture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, wall_specular_texture);
+        item.material = group.material;
+        if (depth_map_set)
+            item.add_texture(SHADOW_MAP_TEXTURE_UNIT, depth_map);
 
-        glDrawElements(GL_TRIANGLES, square_indices.size(), GL_UNSIGNED_INT, 0);
+        queue.submit(pass, item);
     }
-
-    glBindVertexArray(0);
 }
 
 void Room::set_depth_map(unsigned int texture_id)
@@ -1,121 +1,800 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "gl_extensions.hpp"
+#include "shader_preprocessor.hpp"
+#include "spirv.hpp"
+
+// Fixed binding points for uniform blocks shared between programs. Any program
+// declaring one of these blocks has it bound right after linking.
+enum UniformBlockBinding : unsigned int
+{
+    LIGHTING_BLOCK_BINDING = 0,
+    FRAME_BLOCK_BINDING = 1,
+};
+
+const std::vector<std::pair<std::string, unsigned int>> uniform_block_bindings = {
+    {"Lighting", LIGHTING_BLOCK_BINDING},
+    {"Frame", FRAME_BLOCK_BINDING},
+};
+
+// Fixed texture units for known samplers. Any program declaring one of these
+// samplers has it assigned right after linking, so draw code only has to bind
+// textures to the matching unit.
+enum TextureUnit : unsigned int
+{
+    DIFFUSE_TEXTURE_UNIT = 0,
+    SPECULAR_TEXTURE_UNIT = 1,
+    SHADOW_MAP_TEXTURE_UNIT = 2,
+    DEPTH_MAP_TEXTURE_UNIT = 3,
+};
+
+const std::vector<std::pair<std::string, unsigned int>> sampler_bindings = {
+    {"material.texture_diffuse1", DIFFUSE_TEXTURE_UNIT},
+    {"material.texture_specular1", SPECULAR_TEXTURE_UNIT},
+    {"shadow_map", SHADOW_MAP_TEXTURE_UNIT},
+    {"depth_map", DEPTH_MAP_TEXTURE_UNIT},
+};
+
+// Texture unit assigned to a sampler name, or -1 if it has none.
+int sampler_texture_unit(std::string_view name)
+{
+    for (const auto& [sampler, unit] : sampler_bindings)
+        if (sampler == name)
+            return unit;
+
+    return -1;
+}
+
+// Specialization constant IDs of the feature switches in
+// src/common/features.glsl. When a program is loaded from SPIR-V, defines with
+// these names set the constants instead.
+const std::vector<std::pair<std::string, unsigned int>> specialization_constants = {
+    {"NUM_POINT_LIGHTS", 0},
+    {"ENABLE_DIRECTIONAL_LIGHT", 1},
+    {"ENABLE_SPOTLIGHT", 2},
+    {"ENABLE_SHADOWS", 3},
+    {"SHADOW_PCF_RADIUS", 4},
+    {"ENABLE_SPECULAR", 5},
+};
+
+// Specialization constant ID for a define name, or -1 if it has none.
+int specialization_constant_id(std::string_view name)
+{
+    for (const auto& [define, id] : specialization_constants)
+        if (define == name)
+            return id;
+
+    return -1;
+}
+
+// Pre-resolved uniform location. Look it up once with Shader::uniform() and
+// pass it to the setters to skip the name lookup on hot paths.
+struct UniformHandle
+{
+    int location = -1;
+
+    bool valid() const { return location >= 0; }
+};
+
+// Preprocessor defines injected right after the #version line of both stages,
+// as (name, value) pairs.
+using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+std::string inject_defines(const std::string& code, const ShaderDefines& defines)
+{
+    if (defines.empty())
+        return code;
+
+    std::string define_block;
+    for (const auto& [name, value] : defines)
+        define_block += "#define " + name + " " + value + "\n";
+
+    // GLSL requires #version to come first, so insert after that line.
+    std::size_t version_pos = code.find("#version");
+    if (version_pos == std::string::npos)
+        return define_block + code;
+
+    std::size_t line_end = code.find('\n', version_pos);
+    if (line_end == std::string::npos)
+        return code + "\n" + define_block;
+
+    // Keep line numbers in error messages matching the file.
+    std::size_t version_line = std::count(code.begin(), code.begin() + version_pos, '\n') + 1;
+    define_block += "#line " + std::to_string(version_line + 1) + "\n";
+
+    std::string result = code;
+    result.insert(line_end + 1, define_block);
+    return result;
+}
+
+// 64-bit FNV-1a. Pass a previous result as the seed to hash several pieces.
+std::uint64_t hash_fnv1a(std::string_view data,
+    std::uint64_t seed = 14695981039346656037ull)
+{
+    std::uint64_t hash = seed;
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class ShaderBatch;
+
 class Shader
 {
 public:
-    Shader(const std::string& vertex_path, const std::string& fragment_path);
+    Shader(const std::string& vertex_path,
+        const std::string& fragment_path,
+        const ShaderDefines& defines = {});
+
+    // Opt in to caching linked program binaries in the given directory.
+    // Requires load_gl_extensions() to have found program binary support.
+    static void enable_binary_cache(const std::filesystem::path& directory);
+
+    // Opt in to loading programs from SPIR-V modules precompiled into the
+    // given directory, at <directory>/<source path>.spv. Programs fall back
+    // to GLSL when a module is missing, older than its sources, or rejected
+    // by the driver. Requires load_gl_extensions() to have found SPIR-V
+    // support.
+    static void enable_spirv(const std::filesystem::path& directory);
+
+    // True once the program has been checked and its uniforms reflected.
+    bool is_ready() const;
+
+    const std::string& get_vertex_path() const;
+    const std::string& get_fragment_path() const;
+
+    // Every file read to build the program, including resolved #includes.
+    // Source string numbers in GLSL error messages index into this list.
+    const std::vector<std::string>& get_source_files() const;
+
+    // Hash of the fully expanded sources and defines of both stages. Equal
+    // hashes mean identical programs.
+    std::uint64_t get_source_hash() const;
+
+    // Recompile from the source files in the background. The current program
+    // stays in use until finish_reload() swaps in the new one, and is kept if
+    // the new one fails to build. Restarts a reload already in progress.
+    void begin_reload();
+
+    // Complete a reload started by begin_reload(). Without `wait`, returns
+    // false while the driver is still compiling. Handles from uniform() are
+    // invalidated when the program is swapped.
+    bool finish_reload(bool wait);
 
     void use();
 
     unsigned int get_id() const;
 
-    void set_bool(const std::string& name, bool value) const;
-    void set_int(const std::string& name, int value) const;
-    void set_float(const std::string& name, float value) const;
-    void set_vec3(const std::string& name, const glm::vec3& v);
-    void set_mat4fv(const std::string& name, const glm::mat4& transform);
+    UniformHandle uniform(std::string_view name) const;
+
+    // True if the program samples the given texture unit. Draw code uses it
+    // to skip binding textures the program never reads, e.g. in depth passes.
+    bool uses_texture_unit(unsigned int unit) const;
+
+    // Setters do nothing for uniforms the program does not use. With
+    // glProgramUniform available the program need not be current; otherwise
+    // call use() first.
+    void set_bool(std::string_view name, bool value) const;
+    void set_int(std::string_view name, int value) const;
+    void set_float(std::string_view name, float value) const;
+    void set_vec3(std::string_view name, const glm::vec3& v) const;
+    void set_mat4fv(std::string_view name, const glm::mat4& transform) const;
+
+    void set_bool(UniformHandle handle, bool value) const;
+    void set_int(UniformHandle handle, int value) const;
+    void set_float(UniformHandle handle, float value) const;
+    void set_vec3(UniformHandle handle, const glm::vec3& v) const;
+    void set_mat4fv(UniformHandle handle, const glm::mat4& transform) const;
 private:
-    unsigned int id;
+    friend class ShaderBatch;
+
+    // Tag for the constructor that only submits work to the driver.
+    struct Deferred {};
+
+    Shader(Deferred,
+        const std::string& vertex_path,
+        const std::string& fragment_path,
+        const ShaderDefines& defines);
+
+    unsigned int id = 0;
+    bool linked = false;
+
+    // Sources, kept for reloading.
+    std::string vertex_path;
+    std::string fragment_path;
+    ShaderDefines defines;
+    std::vector<std::string> source_files;
+    std::uint64_t source_hash = 0;
+
+    // Replacement program being built by begin_reload().
+    std::unique_ptr<Shader> reloading;
+
+    // Shader objects and cache file of a link that has been submitted but not
+    // yet checked. See submit() and finish().
+    unsigned int vertex_shader = 0;
+    unsigned int fragment_shader = 0;
+    std::filesystem::path pending_cache_path;
+    bool pending = false;
+
+    // Built from SPIR-V modules. The driver keeps no uniform names for these,
+    // so uniform_locations comes from the modules instead.
+    bool from_spirv = false;
+
+    // Locations of all active uniforms, sorted by name. Built once after
+    // linking so setters never have to ask the driver.
+    std::vector<std::pair<std::string, int>> uniform_locations;
+
+    // Bit per texture unit assigned to one of the program's samplers.
+    unsigned int sampler_units = 0;
+
+    inline static std::filesystem::path binary_cache_directory;
+    inline static std::filesystem::path spirv_directory;
+
+    std::filesystem::path binary_cache_path() const;
+    bool load_program_binary(const std::filesystem::path& cache_path);
+    void save_program_binary(const std::filesystem::path& cache_path) const;
+
+    void submit(bool allow_spirv = true);
+    bool submit_spirv();
+    bool link_completed() const;
+    void finish();
+
+    // Delete the replacement program, and its shader objects if its link was
+    // never checked.
+    void discard_reload();
+
+    void reflect_uniforms();
+    void bind_uniform_blocks();
+    void bind_samplers();
 };
 
-Shader::Shader(const std::string& vertex_path, const std::string& fragment_path)
+void Shader::enable_binary_cache(const std::filesystem::path& directory)
 {
-    std::string vertex_code;
-    std::string fragment_code;
-    std::ifstream vertex_shader_file;
-    std::ifstream fragment_shader_file;
+    if (!gl_ext.has_program_binary)
+    {
+        std::cerr << "Shader::enable_binary_cache: program binaries not supported\n";
+        return;
+    }
 
-    vertex_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fragment_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec)
+    {
+        std::cerr << "Shader::enable_binary_cache: cannot create " << directory
+            << ": " << ec.message() << '\n';
+        return;
+    }
 
-    try
+    binary_cache_directory = directory;
+}
+
+void Shader::enable_spirv(const std::filesystem::path& directory)
+{
+    if (!gl_ext.has_gl_spirv)
     {
-        vertex_shader_file.open(vertex_path);
-        fragment_shader_file.open(fragment_path);
+        std::cerr << "Shader::enable_spirv: SPIR-V shaders not supported\n";
+        return;
+    }
 
-        std::stringstream vertex_shader_stream;
-        std::stringstream fragment_shader_stream;
+    spirv_directory = directory;
+}
 
-        vertex_shader_stream << vertex_shader_file.rdbuf();
-        fragment_shader_stream << fragment_shader_file.rdbuf();
+Shader::Shader(const std::string& vertex_path_,
+    const std::string& fragment_path_,
+    const ShaderDefines& defines_) :
+    vertex_path(vertex_path_),
+    fragment_path(fragment_path_),
+    defines(defines_)
+{
+    submit();
+    finish();
+}
 
-        vertex_shader_file.close();
-        fragment_shader_file.close();
+Shader::Shader(Deferred,
+    const std::string& vertex_path_,
+    const std::string& fragment_path_,
+    const ShaderDefines& defines_) :
+    vertex_path(vertex_path_),
+    fragment_path(fragment_path_),
+    defines(defines_)
+{
+    submit();
+}
 
-        vertex_code = vertex_shader_stream.str();
-        fragment_code = fragment_shader_stream.str();
-    }
-    catch (std::ifstream::failure e)
+// Read, compile and link without asking the driver for any status, so the
+// work can proceed in the background until finish() is called.
+void Shader::submit(bool allow_spirv)
+{
+    std::string vertex_code;
+    std::string fragment_code;
+    std::vector<std::string> vertex_files;
+    std::vector<std::string> fragment_files;
+
+    // Resolve #includes. File reads are shared with every other program.
+    if (!ShaderPreprocessor::expand(vertex_path, vertex_code, vertex_files) ||
+        !ShaderPreprocessor::expand(fragment_path, fragment_code, fragment_files))
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ\n";
-        std::cout << e.what() << '\n';
     }
 
+    vertex_code = inject_defines(vertex_code, defines);
+    fragment_code = inject_defines(fragment_code, defines);
+
+    source_files = vertex_files;
+    source_files.insert(source_files.end(), fragment_files.begin(), fragment_files.end());
+
+    source_hash = hash_fnv1a(vertex_code);
+    source_hash = hash_fnv1a(std::string_view("\0", 1), source_hash);
+    source_hash = hash_fnv1a(fragment_code, source_hash);
+
+    // Reuse a cached program binary if the driver accepts it.
+    std::filesystem::path cache_path;
+    if (!binary_cache_directory.empty())
+    {
+        cache_path = binary_cache_path();
+        if (load_program_binary(cache_path))
+        {
+            linked = true;
+            reflect_uniforms();
+            bind_uniform_blocks();
+            bind_samplers();
+            return;
+        }
+    }
+
+    if (allow_spirv && !spirv_directory.empty() && submit_spirv())
+        return;
+
     const char* vertex_shader_source = vertex_code.c_str();
     const char* fragment_shader_source = fragment_code.c_str();
 
-    int success;
-    char info_log[512];
-
     // Create vertex shader object.
-    unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
     glCompileShader(vertex_shader);
 
+    // Create fragment shader object.
+    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
+    glCompileShader(fragment_shader);
+
+    // Build shader program.
+    id = glCreateProgram();
+    glAttachShader(id, vertex_shader);
+    glAttachShader(id, fragment_shader);
+    if (!cache_path.empty())
+        gl_ext.ProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(id);
+
+    pending_cache_path = cache_path;
+    pending = true;
+}
+
+// Create a shader object from a SPIR-V module. Only constants the module
+// declares may be specialized.
+unsigned int create_spirv_shader(GLenum type,
+    const std::vector<std::uint32_t>& module,
+    const std::vector<unsigned int>& module_constant_ids,
+    const std::vector<GLuint>& constant_ids,
+    const std::vector<GLuint>& constant_values)
+{
+    std::vector<GLuint> ids;
+    std::vector<GLuint> values;
+    for (std::size_t i = 0; i < constant_ids.size(); i++)
+    {
+        if (std::find(module_constant_ids.begin(), module_constant_ids.end(),
+            constant_ids[i]) != module_constant_ids.end())
+        {
+            ids.push_back(constant_ids[i]);
+            values.push_back(constant_values[i]);
+        }
+    }
+
+    unsigned int shader = glCreateShader(type);
+    gl_ext.ShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V,
+        module.data(), module.size() * sizeof(std::uint32_t));
+    gl_ext.SpecializeShader(shader, "main", ids.size(), ids.data(), values.data());
+    return shader;
+}
+
+// Submit precompiled SPIR-V modules instead of GLSL. Returns false, having
+// done nothing, if they cannot stand in for the sources.
+bool Shader::submit_spirv()
+{
+    // Modules older than any source file predate an edit.
+    std::error_code ec;
+    auto vertex_module_path = spirv_directory / (vertex_path + ".spv");
+    auto fragment_module_path = spirv_directory / (fragment_path + ".spv");
+    auto vertex_module_time = std::filesystem::last_write_time(vertex_module_path, ec);
+    if (ec)
+        return false;
+    auto fragment_module_time = std::filesystem::last_write_time(fragment_module_path, ec);
+    if (ec)
+        return false;
+
+    auto module_time = std::min(vertex_module_time, fragment_module_time);
+    for (const auto& file : source_files)
+    {
+        auto source_time = std::filesystem::last_write_time(file, ec);
+        if (ec || source_time > module_time)
+            return false;
+    }
+
+    // Defines can only be applied through specialization constants.
+    std::vector<GLuint> constant_ids;
+    std::vector<GLuint> constant_values;
+    for (const auto& [name, value] : defines)
+    {
+        int constant_id = specialization_constant_id(name);
+        if (constant_id < 0)
+            return false;
+
+        constant_ids.push_back(constant_id);
+        constant_values.push_back(std::strtoul(value.c_str(), nullptr, 10));
+    }
+
+    std::vector<std::uint32_t> vertex_module = read_spirv_file(vertex_module_path);
+    std::vector<std::uint32_t> fragment_module = read_spirv_file(fragment_module_path);
+    if (vertex_module.empty() || fragment_module.empty())
+        return false;
+
+    SpirvReflection vertex_reflection = reflect_spirv(vertex_module);
+    SpirvReflection fragment_reflection = reflect_spirv(fragment_module);
+
+    vertex_shader = create_spirv_shader(GL_VERTEX_SHADER, vertex_module,
+        vertex_reflection.specialization_ids, constant_ids, constant_values);
+    fragment_shader = create_spirv_shader(GL_FRAGMENT_SHADER, fragment_module,
+        fragment_reflection.specialization_ids, constant_ids, constant_values);
+
+    id = glCreateProgram();
+    glAttachShader(id, vertex_shader);
+    glAttachShader(id, fragment_shader);
+    glLinkProgram(id);
+
+    // Uniforms declared in both stages share a location.
+    uniform_locations = std::move(vertex_reflection.uniform_locations);
+    uniform_locations.insert(uniform_locations.end(),
+        fragment_reflection.uniform_locations.begin(),
+        fragment_reflection.uniform_locations.end());
+    std::sort(uniform_locations.begin(), uniform_locations.end());
+    uniform_locations.erase(std::unique(uniform_locations.begin(), uniform_locations.end(),
+        [](const auto& a, const auto& b) { return a.first == b.first; }),
+        uniform_locations.end());
+
+    from_spirv = true;
+    pending = true;
+    return true;
+}
+
+// Without KHR_parallel_shader_compile there is no way to ask without
+// blocking, so the link is reported as done and finish() waits for it.
+bool Shader::link_completed() const
+{
+    if (!pending || !gl_ext.has_parallel_shader_compile)
+        return true;
+
+    int completed = GL_FALSE;
+    glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed;
+}
+
+// Check the submitted compile and link, blocking if the driver is still busy.
+void Shader::finish()
+{
+    if (!pending)
+        return;
+    pending = false;
+
+    // The driver has the final say on precompiled modules. Rebuild from GLSL
+    // if it rejects them.
+    if (from_spirv)
+    {
+        int spirv_linked = GL_FALSE;
+        glGetProgramiv(id, GL_LINK_STATUS, &spirv_linked);
+        if (!spirv_linked)
+        {
+            std::cerr << "Shader::finish: SPIR-V rejected for " << vertex_path << ", "
+                << fragment_path << ", compiling GLSL instead\n";
+            gl_state.forget_program(id);
+            glDeleteProgram(id);
+            glDeleteShader(vertex_shader);
+            glDeleteShader(fragment_shader);
+            from_spirv = false;
+            submit(false);
+            finish();
+            return;
+        }
+    }
+
+    int success;
+    char info_log[512];
+    bool compiled = true;
+
     // Check for vertex shader compilation errors.
     glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
     if (!success)
     {
         glGetShaderInfoLog(vertex_shader, 512, NULL, info_log);
         std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << info_log << '\n';
+        compiled = false;
     }
 
-    // Create fragment shader object.
-    unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
-    glCompileShader(fragment_shader);
-
     // Check for fragment shader compilation errors.
     glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
     if (!success)
     {
         glGetShaderInfoLog(fragment_shader, 512, NULL, info_log);
         std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << info_log << '\n';
+        compiled = false;
     }
 
-    // Build shader program.
-    id = glCreateProgram();
-    glAttachShader(id, vertex_shader);
-    glAttachShader(id, fragment_shader);
-    glLinkProgram(id);
+    // Map source string numbers in the logs back to files. Each stage numbers
+    // its own files from zero, in the order they appear here.
+    if (!compiled)
+    {
+        for (const auto& file : source_files)
+            std::cout << "  " << file << '\n';
+    }
 
     // Check for shader program link errors.
     glGetProgramiv(id, GL_LINK_STATUS, &success);
+    linked = success;
     if (!success)
     {
         glGetProgramInfoLog(id, 512, NULL, info_log);
         std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << info_log << '\n';
     }
+    else if (!pending_cache_path.empty())
+    {
+        save_program_binary(pending_cache_path);
+    }
 
     // Delete the shader objects since they've already been linked into the
     // shader program.
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+    vertex_shader = 0;
+    fragment_shader = 0;
+    pending_cache_path.clear();
+
+    reflect_uniforms();
+    bind_uniform_blocks();
+    bind_samplers();
+}
+
+std::filesystem::path Shader::binary_cache_path() const
+{
+    // Binaries are only valid for the exact driver that produced them, so the
+    // driver strings are part of the key.
+    std::uint64_t key = source_hash;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        const char* value = (const char*)glGetString(name);
+        key = hash_fnv1a(std::string_view("\0", 1), key);
+        key = hash_fnv1a(value ? value : "", key);
+    }
+
+    std::ostringstream file_name;
+    file_name << std::hex << key << ".bin";
+    return binary_cache_directory / file_name.str();
+}
+
+bool Shader::load_program_binary(const std::filesystem::path& cache_path)
+{
+    std::ifstream file(cache_path, std::ios::binary);
+    if (!file)
+        return false;
+
+    GLenum format;
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    if (!file)
+        return false;
+
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return false;
+
+    id = glCreateProgram();
+    gl_ext.ProgramBinary(id, format, binary.data(), binary.size());
+
+    // Drivers reject binaries after updates. Fall back to compiling.
+    int success;
+    glGetProgramiv(id, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(id);
+        id = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void Shader::save_program_binary(const std::filesystem::path& cache_path) const
+{
+    int length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    GLenum format;
+    std::vector<char> binary(length);
+    gl_ext.GetProgramBinary(id, length, nullptr, &format, binary.data());
+
+    std::ofstream file(cache_path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Shader::save_program_binary: cannot write " << cache_path << '\n';
+        return;
+    }
+
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), binary.size());
+}
+
+void Shader::reflect_uniforms()
+{
+    // Already taken from the modules by submit_spirv().
+    if (from_spirv)
+        return;
+
+    uniform_locations.clear();
+
+    int num_uniforms = 0;
+    int max_name_length = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &num_uniforms);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+    std::vector<char> name_buffer(max_name_length + 1);
+    for (int i = 0; i < num_uniforms; i++)
+    {
+        int name_length = 0;
+        int size = 0;
+        GLenum type;
+        glGetActiveUniform(id, i, name_buffer.size(), &name_length, &size,
+            &type, name_buffer.data());
+
+        std::string name(name_buffer.data(), name_length);
+
+        // Uniforms inside uniform blocks have no location.
+        int location = glGetUniformLocation(id, name.c_str());
+        if (location < 0)
+            continue;
+
+        uniform_locations.emplace_back(name, location);
+
+        // Arrays of basic types are reported once as "name[0]". Register the
+        // bare name and every other element as well.
+        const std::string array_suffix{"[0]"};
+        if (name.size() > array_suffix.size() &&
+            name.compare(name.size() - array_suffix.size(), array_suffix.size(), array_suffix) == 0)
+        {
+            std::string base_name = name.substr(0, name.size() - array_suffix.size());
+            uniform_locations.emplace_back(base_name, location);
+
+            for (int j = 1; j < size; j++)
+            {
+                std::string element_name = base_name + "[" + std::to_string(j) + "]";
+                int element_location = glGetUniformLocation(id, element_name.c_str());
+                if (element_location >= 0)
+                    uniform_locations.emplace_back(element_name, element_location);
+            }
+        }
+    }
+
+    std::sort(uniform_locations.begin(), uniform_locations.end());
+}
+
+bool Shader::is_ready() const
+{
+    return !pending;
+}
+
+const std::string& Shader::get_vertex_path() const
+{
+    return vertex_path;
+}
+
+const std::string& Shader::get_fragment_path() const
+{
+    return fragment_path;
+}
+
+const std::vector<std::string>& Shader::get_source_files() const
+{
+    return source_files;
+}
+
+std::uint64_t Shader::get_source_hash() const
+{
+    return source_hash;
+}
+
+void Shader::begin_reload()
+{
+    discard_reload();
+    reloading.reset(new Shader(Deferred{}, vertex_path, fragment_path, defines));
+}
+
+bool Shader::finish_reload(bool wait)
+{
+    if (!reloading)
+        return true;
+
+    if (!wait && !reloading->link_completed())
+        return false;
+
+    reloading->finish();
+
+    if (reloading->linked)
+    {
+        // Swap programs. Only this shader's uniform table is replaced.
+        gl_state.forget_program(id);
+        glDeleteProgram(id);
+        id = reloading->id;
+        linked = true;
+        uniform_locations = std::move(reloading->uniform_locations);
+        sampler_units = reloading->sampler_units;
+        from_spirv = reloading->from_spirv;
+        source_files = std::move(reloading->source_files);
+        source_hash = reloading->source_hash;
+        std::cout << "Reloaded " << vertex_path << ", " << fragment_path << '\n';
+    }
+    else
+    {
+        std::cerr << "Shader::finish_reload: keeping previous program for "
+            << vertex_path << ", " << fragment_path << '\n';
+        discard_reload();
+    }
+
+    reloading.reset();
+    return true;
+}
+
+void Shader::discard_reload()
+{
+    if (!reloading)
+        return;
+
+    if (reloading->pending)
+    {
+        glDeleteShader(reloading->vertex_shader);
+        glDeleteShader(reloading->fragment_shader);
+    }
+
+    gl_state.forget_program(reloading->id);
+    glDeleteProgram(reloading->id);
+    reloading.reset();
 }
 
 void Shader::use()
 {
-    glUseProgram(id);
+    // A batched program used before its batch finished is completed here.
+    finish();
+    gl_state.use_program(id);
 }
 
 unsigned int Shader::get_id() const
@@ -123,29 +802,203 @@ unsigned int Shader::get_id() const
     return id;
 }
 
-void Shader::set_bool(const std::string& name, bool value) const
+void Shader::bind_uniform_blocks()
+{
+    for (const auto& [name, binding] : uniform_block_bindings)
+    {
+        unsigned int index = glGetUniformBlockIndex(id, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(id, index, binding);
+    }
+}
+
+void Shader::bind_samplers()
+{
+    // Without glProgramUniform, sampler uniforms can only be set on the
+    // current program.
+    int previous_program = 0;
+    if (!gl_ext.has_program_uniform)
+    {
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+        glUseProgram(id);
+    }
+
+    sampler_units = 0;
+    for (const auto& [name, unit] : sampler_bindings)
+    {
+        UniformHandle handle = uniform(name);
+        if (handle.valid())
+        {
+            set_int(handle, unit);
+            sampler_units |= 1u << unit;
+        }
+    }
+
+    if (!gl_ext.has_program_uniform)
+        glUseProgram(previous_program);
+}
+
+UniformHandle Shader::uniform(std::string_view name) const
 {
-    glUniform1i(glGetUniformLocation(id, name.c_str()), (int)value);
+    auto it = std::lower_bound(uniform_locations.begin(), uniform_locations.end(), name,
+        [](const std::pair<std::string, int>& entry, std::string_view n) {
+            return std::string_view(entry.first) < n;
+        });
+
+    if (it == uniform_locations.end() || it->first != name)
+        return UniformHandle{};
+
+    return UniformHandle{it->second};
 }
 
-void Shader::set_int(const std::string& name, int value) const
+bool Shader::uses_texture_unit(unsigned int unit) const
 {
-    glUniform1i(glGetUniformLocation(id, name.c_str()), value);
+    return sampler_units & (1u << unit);
 }
 
-void Shader::set_float(const std::string& name, float value) const
+void Shader::set_bool(std::string_view name, bool value) const
 {
-    glUniform1f(glGetUniformLocation(id, name.c_str()), value);
+    set_bool(uniform(name), value);
 }
 
-void Shader::set_vec3(const std::string& name, const glm::vec3& v)
+void Shader::set_int(std::string_view name, int value) const
 {
-    glUniform3f(glGetUniformLocation(id, name.c_str()), v.x, v.y, v.z);
+    set_int(uniform(name), value);
+}
+
+void Shader::set_float(std::string_view name, float value) const
+{
+    set_float(uniform(name), value);
+}
+
+void Shader::set_vec3(std::string_view name, const glm::vec3& v) const
+{
+    set_vec3(uniform(name), v);
+}
+
+void Shader::set_mat4fv(std::string_view name, const glm::mat4& transform) const
+{
+    set_mat4fv(uniform(name), transform);
+}
+
+void Shader::set_bool(UniformHandle handle, bool value) const
+{
+    if (!handle.valid())
+        return;
+
+    if (gl_ext.has_program_uniform)
+        gl_ext.ProgramUniform1i(id, handle.location, (int)value);
+    else
+        glUniform1i(handle.location, (int)value);
+}
+
+void Shader::set_int(UniformHandle handle, int value) const
+{
+    if (!handle.valid())
+        return;
+
+    if (gl_ext.has_program_uniform)
+        gl_ext.ProgramUniform1i(id, handle.location, value);
+    else
+        glUniform1i(handle.location, value);
+}
+
+void Shader::set_float(UniformHandle handle, float value) const
+{
+    if (!handle.valid())
+        return;
+
+    if (gl_ext.has_program_uniform)
+        gl_ext.ProgramUniform1f(id, handle.location, value);
+    else
+        glUniform1f(handle.location, value);
+}
+
+void Shader::set_vec3(UniformHandle handle, const glm::vec3& v) const
+{
+    if (!handle.valid())
+        return;
+
+    if (gl_ext.has_program_uniform)
+        gl_ext.ProgramUniform3f(id, handle.location, v.x, v.y, v.z);
+    else
+        glUniform3f(handle.location, v.x, v.y, v.z);
+}
+
+void Shader::set_mat4fv(UniformHandle handle, const glm::mat4& transform) const
+{
+    if (!handle.valid())
+        return;
+
+    if (gl_ext.has_program_uniform)
+        gl_ext.ProgramUniformMatrix4fv(id, handle.location, 1, GL_FALSE, glm::value_ptr(transform));
+    else
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(transform));
+}
+
+/*
+ * Compiles several programs without stalling on each one. Every program added
+ * is submitted right away, and nothing asks the driver for a status until the
+ * batch is polled or finished. With KHR_parallel_shader_compile the driver
+ * compiles on its own threads; without it the deferred checks still let the
+ * driver pipeline the work.
+ *
+ * Programs returned by add() must outlive the batch or be finished first.
+ */
+class ShaderBatch
+{
+public:
+    std::unique_ptr<Shader> add(const std::string& vertex_path,
+        const std::string& fragment_path,
+        const ShaderDefines& defines = {});
+
+    // Finish every program whose link has completed. Never blocks when
+    // parallel compilation is available. Returns true once nothing is left.
+    bool poll();
+
+    // Finish every remaining program, blocking as needed.
+    void finish();
+private:
+    std::vector<Shader*> pending;
+};
+
+std::unique_ptr<Shader> ShaderBatch::add(const std::string& vertex_path,
+    const std::string& fragment_path,
+    const ShaderDefines& defines)
+{
+    std::unique_ptr<Shader> shader(
+        new Shader(Shader::Deferred{}, vertex_path, fragment_path, defines));
+
+    if (!shader->is_ready())
+        pending.push_back(shader.get());
+
+    return shader;
+}
+
+bool ShaderBatch::poll()
+{
+    if (!gl_ext.has_parallel_shader_compile)
+    {
+        finish();
+        return true;
+    }
+
+    auto done = std::remove_if(pending.begin(), pending.end(), [](Shader* shader) {
+        if (!shader->link_completed())
+            return false;
+        shader->finish();
+        return true;
+    });
+    pending.erase(done, pending.end());
+
+    return pending.empty();
 }
 
-void Shader::set_mat4fv(const std::string& name, const glm::mat4& transform)
+void ShaderBatch::finish()
 {
-    glUniformMatrix4fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, glm::value_ptr(transform));
+    for (Shader* shader : pending)
+        shader->finish();
+    pending.clear();
 }
 
 #endif /* SHADER_HPP */
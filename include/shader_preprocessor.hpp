@@ -0,0 +1,199 @@
+#ifndef SHADER_PREPROCESSOR_HPP
+#define SHADER_PREPROCESSOR_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Expands #include "file" directives in GLSL sources. Paths resolve relative
+ * to the including file first, then to each include directory in the order
+ * they were added. A file is included at most once per program.
+ *
+ * File reads are memoized across programs. A cached file is read again only
+ * when its modification time changes, so edits are still picked up when
+ * shaders are reloaded.
+ */
+class ShaderPreprocessor
+{
+public:
+    static void add_include_directory(const std::filesystem::path& directory);
+
+    // Expand `path` into `source`. `files` receives every file read, starting
+    // with `path` itself. Returns false if any file could not be read.
+    static bool expand(const std::filesystem::path& path,
+        std::string& source,
+        std::vector<std::string>& files);
+private:
+    struct CachedFile
+    {
+        std::filesystem::file_time_type write_time;
+        std::string text;
+    };
+
+    inline static std::vector<std::filesystem::path> include_directories;
+    inline static std::unordered_map<std::string, CachedFile> file_cache;
+
+    static const std::string* read(const std::filesystem::path& path);
+    static bool find_include(const std::filesystem::path& including_file,
+        const std::string& name,
+        std::filesystem::path& result);
+    static bool parse_include(std::string_view line, std::string& name);
+    static bool expand_file(const std::filesystem::path& path,
+        std::string& source,
+        std::vector<std::string>& files);
+};
+
+void ShaderPreprocessor::add_include_directory(const std::filesystem::path& directory)
+{
+    include_directories.push_back(directory);
+}
+
+bool ShaderPreprocessor::expand(const std::filesystem::path& path,
+    std::string& source,
+    std::vector<std::string>& files)
+{
+    source.clear();
+    files.clear();
+    return expand_file(path.lexically_normal(), source, files);
+}
+
+const std::string* ShaderPreprocessor::read(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    auto write_time = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return nullptr;
+
+    auto it = file_cache.find(path.string());
+    if (it != file_cache.end() && it->second.write_time == write_time)
+        return &it->second.text;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return nullptr;
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+
+    CachedFile& cached = file_cache[path.string()];
+    cached.write_time = write_time;
+    cached.text = stream.str();
+    return &cached.text;
+}
+
+bool ShaderPreprocessor::find_include(const std::filesystem::path& including_file,
+    const std::string& name,
+    std::filesystem::path& result)
+{
+    std::filesystem::path candidate = (including_file.parent_path() / name).lexically_normal();
+    if (std::filesystem::exists(candidate))
+    {
+        result = candidate;
+        return true;
+    }
+
+    for (const auto& directory : include_directories)
+    {
+        candidate = (directory / name).lexically_normal();
+        if (std::filesystem::exists(candidate))
+        {
+            result = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Match `#include "name"`, allowing whitespace around the tokens.
+bool ShaderPreprocessor::parse_include(std::string_view line, std::string& name)
+{
+    std::size_t pos = line.find_first_not_of(" \t");
+    if (pos == std::string_view::npos || line[pos] != '#')
+        return false;
+
+    pos = line.find_first_not_of(" \t", pos + 1);
+    const std::string_view directive = "include";
+    if (pos == std::string_view::npos || line.compare(pos, directive.size(), directive) != 0)
+        return false;
+
+    std::size_t open = line.find('"', pos + directive.size());
+    std::size_t close = open == std::string_view::npos ? open : line.find('"', open + 1);
+    if (close == std::string_view::npos)
+        return false;
+
+    name = std::string(line.substr(open + 1, close - open - 1));
+    return true;
+}
+
+bool ShaderPreprocessor::expand_file(const std::filesystem::path& path,
+    std::string& source,
+    std::vector<std::string>& files)
+{
+    // Include once.
+    for (const auto& file : files)
+        if (file == path.string())
+            return true;
+
+    const std::string* text = read(path);
+    if (!text)
+    {
+        std::cerr << "ShaderPreprocessor::expand: cannot read " << path << '\n';
+        return false;
+    }
+
+    // GLSL #line directives take a source string number rather than a file
+    // name. Use the index into `files` so errors can be traced back.
+    const std::size_t file_index = files.size();
+    files.push_back(path.string());
+
+    bool success = true;
+    std::size_t line_number = 0;
+    std::size_t begin = 0;
+    while (begin < text->size())
+    {
+        std::size_t end = text->find('\n', begin);
+        if (end == std::string::npos)
+            end = text->size();
+        else
+            end++;
+
+        std::string_view line(text->data() + begin, end - begin);
+        begin = end;
+        line_number++;
+
+        std::string name;
+        if (!parse_include(line, name))
+        {
+            source.append(line);
+            continue;
+        }
+
+        std::filesystem::path include_path;
+        if (!find_include(path, name, include_path))
+        {
+            std::cerr << "ShaderPreprocessor::expand: " << path << ":" << line_number
+                << ": cannot find \"" << name << "\"\n";
+            success = false;
+            continue;
+        }
+
+        source += "#line 1 " + std::to_string(files.size()) + "\n";
+        success = expand_file(include_path, source, files) && success;
+        if (!source.empty() && source.back() != '\n')
+            source += '\n';
+        source += "#line " + std::to_string(line_number + 1) + " " +
+            std::to_string(file_index) + "\n";
+    }
+
+    return success;
+}
+
+#endif /* SHADER_PREPROCESSOR_HPP */
@@ -0,0 +1,202 @@
+#ifndef SHADER_VARIANTS_HPP
+#define SHADER_VARIANTS_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "lights.hpp"
+#include "shader.hpp"
+
+// Compile-time features of a lighting program. Each distinct combination is
+// compiled into its own specialized program, so the shader never branches or
+// loops on anything known up front.
+struct ShaderFeatures
+{
+    unsigned int num_point_lights = 1;
+    bool directional_light = false;
+    bool spotlight = false;
+    bool shadows = false;
+    unsigned int pcf_radius = 0;
+    bool specular = true;
+
+    std::uint32_t key() const;
+    ShaderDefines defines() const;
+};
+
+std::uint32_t ShaderFeatures::key() const
+{
+    // Wider values would collide with other variants' keys.
+    assert(num_point_lights <= 0xff);
+    assert(pcf_radius <= 0xffff);
+
+    return num_point_lights |
+        (std::uint32_t(directional_light) << 8) |
+        (std::uint32_t(spotlight) << 9) |
+        (std::uint32_t(shadows) << 10) |
+        (std::uint32_t(specular) << 11) |
+        (pcf_radius << 16);
+}
+
+ShaderDefines ShaderFeatures::defines() const
+{
+    return {
+        {"NUM_POINT_LIGHTS", std::to_string(num_point_lights)},
+        {"ENABLE_DIRECTIONAL_LIGHT", directional_light ? "1" : "0"},
+        {"ENABLE_SPOTLIGHT", spotlight ? "1" : "0"},
+        {"ENABLE_SHADOWS", shadows ? "1" : "0"},
+        {"SHADOW_PCF_RADIUS", std::to_string(pcf_radius)},
+        {"ENABLE_SPECULAR", specular ? "1" : "0"},
+    };
+}
+
+// Light features for whatever is actually present in the scene. Shadow
+// settings are render options and are left for the caller to fill in.
+ShaderFeatures features_from_lighting(const SceneLighting& sl)
+{
+    ShaderFeatures features;
+
+    features.num_point_lights = std::count_if(sl.points.begin(), sl.points.end(),
+        [](const std::shared_ptr<PointLight>& point) { return point != nullptr; });
+    features.num_point_lights = std::min<unsigned int>(features.num_point_lights, MAX_POINT_LIGHTS);
+
+    features.directional_light = sl.dir != nullptr;
+    features.spotlight = sl.spot != nullptr;
+
+    return features;
+}
+
+// Lighting levels of detail, from full quality down.
+enum class ShaderLod
+{
+    FULL,
+    REDUCED,
+    MINIMAL,
+};
+
+// When objects switch to cheaper lighting. An object drops a level once it is
+// farther away than the distance, or once its projected diameter covers less
+// than the given fraction of the viewport height.
+struct ShaderLodThresholds
+{
+    float reduced_distance = 15.0f;
+    float reduced_screen_size = 0.2f;
+    float minimal_distance = 30.0f;
+    float minimal_screen_size = 0.05f;
+};
+
+// Pick a level for a bounding sphere seen from `camera_pos` with a vertical
+// field of view of `fov` degrees.
+ShaderLod select_shader_lod(const ShaderLodThresholds& thresholds,
+    const glm::vec3& center,
+    float radius,
+    const glm::vec3& camera_pos,
+    float fov)
+{
+    float distance = glm::length(center - camera_pos);
+    if (distance <= radius)
+        return ShaderLod::FULL;
+
+    float screen_size = radius / (distance * std::tan(glm::radians(fov) * 0.5f));
+
+    if (distance > thresholds.minimal_distance || screen_size < thresholds.minimal_screen_size)
+        return ShaderLod::MINIMAL;
+    if (distance > thresholds.reduced_distance || screen_size < thresholds.reduced_screen_size)
+        return ShaderLod::REDUCED;
+
+    return ShaderLod::FULL;
+}
+
+// Reduced lighting takes a single shadow tap and skips the spotlight. Minimal
+// lighting also drops specular.
+ShaderFeatures apply_shader_lod(ShaderFeatures features, ShaderLod lod)
+{
+    if (lod == ShaderLod::FULL)
+        return features;
+
+    features.pcf_radius = 0;
+    features.spotlight = false;
+
+    if (lod == ShaderLod::MINIMAL)
+        features.specular = false;
+
+    return features;
+}
+
+// Specialized programs built from one vertex/fragment source pair. Variants
+// are compiled on first use and kept for the lifetime of the object.
+class ShaderVariants
+{
+public:
+    ShaderVariants(const std::string& vertex_path_, const std::string& fragment_path_) :
+        vertex_path(vertex_path_),
+        fragment_path(fragment_path_)
+    {
+    }
+
+    Shader* get(const ShaderFeatures& features);
+
+    // Queue a variant on a batch so it compiles alongside other programs
+    // instead of stalling the first frame that needs it.
+    void precompile(ShaderBatch& batch, const ShaderFeatures& features);
+
+    const std::string& get_vertex_path() const;
+    const std::string& get_fragment_path() const;
+
+    // Every variant compiled so far.
+    std::vector<Shader*> compiled() const;
+private:
+    std::string vertex_path;
+    std::string fragment_path;
+
+    std::unordered_map<std::uint32_t, std::unique_ptr<Shader>> variants;
+};
+
+Shader* ShaderVariants::get(const ShaderFeatures& features)
+{
+    auto it = variants.find(features.key());
+    if (it == variants.end())
+    {
+        it = variants.emplace(features.key(),
+            std::make_unique<Shader>(vertex_path, fragment_path, features.defines())).first;
+    }
+
+    return it->second.get();
+}
+
+void ShaderVariants::precompile(ShaderBatch& batch, const ShaderFeatures& features)
+{
+    if (variants.count(features.key()))
+        return;
+
+    variants.emplace(features.key(),
+        batch.add(vertex_path, fragment_path, features.defines()));
+}
+
+const std::string& ShaderVariants::get_vertex_path() const
+{
+    return vertex_path;
+}
+
+const std::string& ShaderVariants::get_fragment_path() const
+{
+    return fragment_path;
+}
+
+std::vector<Shader*> ShaderVariants::compiled() const
+{
+    std::vector<Shader*> shaders;
+    for (const auto& [key, shader] : variants)
+        shaders.push_back(shader.get());
+
+    return shaders;
+}
+
+#endif /* SHADER_VARIANTS_HPP */
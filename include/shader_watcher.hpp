@@ -0,0 +1,230 @@
+#ifndef SHADER_WATCHER_HPP
+#define SHADER_WATCHER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "shader.hpp"
+#include "shader_variants.hpp"
+
+/*
+ * Reloads shaders whose source files, including resolved #includes, change on
+ * disk. Directories are watched rather than files since most editors save by
+ * renaming a new file into place. Only implemented on Linux through inotify;
+ * elsewhere it does nothing.
+ *
+ * All GL work happens in poll(), which must be called on the GL thread.
+ */
+class ShaderWatcher
+{
+public:
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    void watch(Shader* shader);
+    void watch(ShaderVariants* variants);
+
+    // Start reloads for changed files and swap in the ones that are done.
+    // Waiting on the driver stops once the budget is used up, and whatever is
+    // left is picked up by the next call.
+    void poll(std::chrono::microseconds budget = std::chrono::microseconds(2000));
+private:
+    int fd = -1;
+
+    // Watched directory for each watch descriptor.
+    std::map<int, std::filesystem::path> directories;
+
+    std::vector<Shader*> shaders;
+    std::vector<ShaderVariants*> variant_sets;
+
+    // Number of compiled variants seen for each variant set, so directories
+    // of newly compiled variants get watched.
+    std::vector<std::size_t> variant_counts;
+
+    // Shaders with a reload in flight.
+    std::vector<Shader*> reloading;
+
+    static std::filesystem::path normalize(const std::filesystem::path& path);
+
+    void watch_directory(const std::string& file_path);
+    void watch_sources(const Shader* shader);
+    std::set<std::filesystem::path> read_changes();
+    void reload_if_uses(Shader* shader, const std::set<std::filesystem::path>& changed);
+};
+
+ShaderWatcher::ShaderWatcher()
+{
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        std::cerr << "ShaderWatcher::ShaderWatcher: inotify unavailable\n";
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+void ShaderWatcher::watch(Shader* shader)
+{
+    shaders.push_back(shader);
+    watch_sources(shader);
+}
+
+void ShaderWatcher::watch(ShaderVariants* variants)
+{
+    variant_sets.push_back(variants);
+    variant_counts.push_back(0);
+    watch_directory(variants->get_vertex_path());
+    watch_directory(variants->get_fragment_path());
+}
+
+void ShaderWatcher::poll(std::chrono::microseconds budget)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < variant_sets.size(); i++)
+    {
+        std::vector<Shader*> compiled = variant_sets[i]->compiled();
+        if (compiled.size() == variant_counts[i])
+            continue;
+
+        for (Shader* shader : compiled)
+            watch_sources(shader);
+        variant_counts[i] = compiled.size();
+    }
+
+    std::set<std::filesystem::path> changed = read_changes();
+    if (!changed.empty())
+    {
+        for (Shader* shader : shaders)
+            reload_if_uses(shader, changed);
+
+        // Variants are looked up each time since new ones compile on demand.
+        for (ShaderVariants* variants : variant_sets)
+            for (Shader* shader : variants->compiled())
+                reload_if_uses(shader, changed);
+    }
+
+    // Swap in finished reloads. With parallel compilation this never blocks;
+    // without it each finish waits for the driver, so respect the budget.
+    auto it = reloading.begin();
+    while (it != reloading.end())
+    {
+        if (std::chrono::steady_clock::now() - start > budget)
+            break;
+
+        if ((*it)->finish_reload(false))
+        {
+            // The new sources may include files from directories not yet
+            // watched.
+            watch_sources(*it);
+            it = reloading.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+std::filesystem::path ShaderWatcher::normalize(const std::filesystem::path& path)
+{
+    return std::filesystem::absolute(path).lexically_normal();
+}
+
+void ShaderWatcher::watch_directory(const std::string& file_path)
+{
+#ifdef __linux__
+    if (fd < 0)
+        return;
+
+    std::filesystem::path directory = normalize(file_path).parent_path();
+    for (const auto& [wd, watched] : directories)
+        if (watched == directory)
+            return;
+
+    int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0)
+    {
+        std::cerr << "ShaderWatcher::watch_directory: cannot watch " << directory << '\n';
+        return;
+    }
+
+    directories[wd] = directory;
+#endif
+}
+
+void ShaderWatcher::watch_sources(const Shader* shader)
+{
+    watch_directory(shader->get_vertex_path());
+    watch_directory(shader->get_fragment_path());
+    for (const auto& file : shader->get_source_files())
+        watch_directory(file);
+}
+
+std::set<std::filesystem::path> ShaderWatcher::read_changes()
+{
+    std::set<std::filesystem::path> changed;
+
+#ifdef __linux__
+    if (fd < 0)
+        return changed;
+
+    alignas(inotify_event) char buffer[4096];
+    while (true)
+    {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+
+        for (char* p = buffer; p < buffer + length; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            auto directory = directories.find(event->wd);
+            if (directory != directories.end() && event->len > 0)
+                changed.insert(directory->second / event->name);
+
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+#endif
+
+    return changed;
+}
+
+void ShaderWatcher::reload_if_uses(Shader* shader,
+    const std::set<std::filesystem::path>& changed)
+{
+    bool uses_changed_file = changed.count(normalize(shader->get_vertex_path())) ||
+        changed.count(normalize(shader->get_fragment_path()));
+    for (const auto& file : shader->get_source_files())
+        uses_changed_file = uses_changed_file || changed.count(normalize(file));
+
+    if (!uses_changed_file)
+        return;
+
+    shader->begin_reload();
+    if (std::find(reloading.begin(), reloading.end(), shader) == reloading.end())
+        reloading.push_back(shader);
+}
+
+#endif /* SHADER_WATCHER_HPP */
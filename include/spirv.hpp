@@ -0,0 +1,240 @@
+#ifndef SPIRV_HPP
+#define SPIRV_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Minimal inspection of SPIR-V modules loaded through ARB_gl_spirv. Drivers
+ * ignore names in SPIR-V programs, so uniform locations and specialization
+ * constants are read from the module itself.
+ */
+struct SpirvReflection
+{
+    // Locations of uniforms outside blocks, named the way glGetActiveUniform
+    // would name them, e.g. "material.shininess" or "lights[2]".
+    std::vector<std::pair<std::string, int>> uniform_locations;
+
+    // IDs of the specialization constants the module declares.
+    std::vector<unsigned int> specialization_ids;
+};
+
+// Returns no words if the file is missing or is not a SPIR-V module.
+std::vector<std::uint32_t> read_spirv_file(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return {};
+
+    std::size_t size = file.tellg();
+    if (size < 5 * sizeof(std::uint32_t) || size % sizeof(std::uint32_t) != 0)
+        return {};
+
+    std::vector<std::uint32_t> words(size / sizeof(std::uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(words.data()), size);
+    if (!file || words[0] != 0x07230203)
+        return {};
+
+    return words;
+}
+
+namespace spirv_detail
+{
+
+// Opcodes, decorations and storage classes used below.
+enum : std::uint32_t
+{
+    OP_NAME = 5,
+    OP_MEMBER_NAME = 6,
+    OP_TYPE_ARRAY = 28,
+    OP_TYPE_STRUCT = 30,
+    OP_TYPE_POINTER = 32,
+    OP_CONSTANT = 43,
+    OP_VARIABLE = 59,
+    OP_DECORATE = 71,
+
+    DECORATION_SPEC_ID = 1,
+    DECORATION_LOCATION = 30,
+
+    STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+};
+
+struct Module
+{
+    std::map<std::uint32_t, std::string> names;
+    std::map<std::uint32_t, std::vector<std::string>> member_names;
+    std::map<std::uint32_t, std::vector<std::uint32_t>> struct_members;
+    std::map<std::uint32_t, std::pair<std::uint32_t, std::uint32_t>> arrays;  // Element type, length ID.
+    std::map<std::uint32_t, std::uint32_t> constants;
+    std::map<std::uint32_t, std::uint32_t> pointee_types;
+    std::map<std::uint32_t, int> locations;
+};
+
+// Strings are packed four bytes per word and nul-terminated.
+std::string read_string(const std::uint32_t* words, std::size_t count)
+{
+    std::string result;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        for (int byte = 0; byte < 4; byte++)
+        {
+            char c = (char)((words[i] >> (8 * byte)) & 0xff);
+            if (c == '\0')
+                return result;
+            result += c;
+        }
+    }
+    return result;
+}
+
+// Uniform locations used by a value of the given type. Every non-aggregate
+// member takes one location, matrices included.
+int location_count(const Module& module, std::uint32_t type)
+{
+    auto array = module.arrays.find(type);
+    if (array != module.arrays.end())
+    {
+        auto length = module.constants.find(array->second.second);
+        int elements = length != module.constants.end() ? length->second : 1;
+        return elements * location_count(module, array->second.first);
+    }
+
+    auto members = module.struct_members.find(type);
+    if (members != module.struct_members.end())
+    {
+        int count = 0;
+        for (std::uint32_t member : members->second)
+            count += location_count(module, member);
+        return count;
+    }
+
+    return 1;
+}
+
+void add_uniform(const Module& module,
+    const std::string& name,
+    std::uint32_t type,
+    int location,
+    std::vector<std::pair<std::string, int>>& result)
+{
+    auto array = module.arrays.find(type);
+    if (array != module.arrays.end())
+    {
+        auto length = module.constants.find(array->second.second);
+        int elements = length != module.constants.end() ? length->second : 1;
+        int stride = location_count(module, array->second.first);
+
+        // Arrays of basic types are also reachable through their bare name.
+        if (!module.arrays.count(array->second.first) &&
+            !module.struct_members.count(array->second.first))
+            result.emplace_back(name, location);
+
+        for (int i = 0; i < elements; i++)
+        {
+            add_uniform(module, name + "[" + std::to_string(i) + "]",
+                array->second.first, location + i * stride, result);
+        }
+        return;
+    }
+
+    auto members = module.struct_members.find(type);
+    if (members != module.struct_members.end())
+    {
+        auto names = module.member_names.find(type);
+        for (std::size_t i = 0; i < members->second.size(); i++)
+        {
+            std::string member_name = names != module.member_names.end() &&
+                i < names->second.size() ? names->second[i] : std::to_string(i);
+            add_uniform(module, name + "." + member_name, members->second[i], location, result);
+            location += location_count(module, members->second[i]);
+        }
+        return;
+    }
+
+    result.emplace_back(name, location);
+}
+
+}  // namespace spirv_detail
+
+SpirvReflection reflect_spirv(const std::vector<std::uint32_t>& words)
+{
+    using namespace spirv_detail;
+
+    SpirvReflection reflection;
+    Module module;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> variables;  // Pointer type, ID.
+
+    // Skip the five word header.
+    std::size_t i = 5;
+    while (i < words.size())
+    {
+        std::uint32_t opcode = words[i] & 0xffff;
+        std::uint32_t count = words[i] >> 16;
+        if (count == 0 || i + count > words.size())
+            break;
+
+        const std::uint32_t* op = &words[i];
+        switch (opcode)
+        {
+        case OP_NAME:
+            module.names[op[1]] = read_string(op + 2, count - 2);
+            break;
+        case OP_MEMBER_NAME:
+        {
+            auto& names = module.member_names[op[1]];
+            if (names.size() <= op[2])
+                names.resize(op[2] + 1);
+            names[op[2]] = read_string(op + 3, count - 3);
+            break;
+        }
+        case OP_TYPE_ARRAY:
+            module.arrays[op[1]] = {op[2], op[3]};
+            break;
+        case OP_TYPE_STRUCT:
+            module.struct_members[op[1]].assign(op + 2, op + count);
+            break;
+        case OP_TYPE_POINTER:
+            module.pointee_types[op[1]] = op[3];
+            break;
+        case OP_CONSTANT:
+            if (count > 3)
+                module.constants[op[2]] = op[3];
+            break;
+        case OP_VARIABLE:
+            if (op[3] == STORAGE_CLASS_UNIFORM_CONSTANT)
+                variables.emplace_back(op[1], op[2]);
+            break;
+        case OP_DECORATE:
+            if (op[2] == DECORATION_LOCATION && count > 3)
+                module.locations[op[1]] = op[3];
+            else if (op[2] == DECORATION_SPEC_ID && count > 3)
+                reflection.specialization_ids.push_back(op[3]);
+            break;
+        }
+
+        i += count;
+    }
+
+    for (const auto& [pointer_type, id] : variables)
+    {
+        auto location = module.locations.find(id);
+        auto name = module.names.find(id);
+        auto type = module.pointee_types.find(pointer_type);
+        if (location == module.locations.end() || name == module.names.end() ||
+            type == module.pointee_types.end())
+            continue;
+
+        add_uniform(module, name->second, type->second, location->second,
+            reflection.uniform_locations);
+    }
+
+    return reflection;
+}
+
+#endif /* SPIRV_HPP */
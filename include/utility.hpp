@@ -1,13 +1,20 @@
 #ifndef UTILITY_HPP
 #define UTILITY_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <filesystem>
 
+#include "gl_extensions.hpp"
+
 unsigned int load_texture_from_file(const std::filesystem::path texture_path)
 {
     // Create texture ID.
     unsigned int texture;
-    glGenTextures(1, &texture);
+    if (gl_ext.has_direct_state_access)
+        gl_ext.CreateTextures(GL_TEXTURE_2D, 1, &texture);
+    else
+        glGenTextures(1, &texture);
 
     // Load texture.
     int width;
@@ -18,15 +25,43 @@ unsigned int load_texture_from_file(const std::filesystem::path texture_path)
     if (data)
     {
         GLenum format;
+        GLenum internal_format;
         if (num_channels == 1)
+        {
             format = GL_RED;
+            internal_format = GL_R8;
+        }
         else if (num_channels == 3)
+        {
             format = GL_RGB;
+            internal_format = GL_RGB8;
+        }
         else if (num_channels == 4)
+        {
             format = GL_RGBA;
+            internal_format = GL_RGBA8;
+        }
+
+        if (gl_ext.has_direct_state_access)
+        {
+            // Generate texture without touching texture bindings.
+            int levels = 1 + (int)std::floor(std::log2(std::max(width, height)));
+            gl_ext.TextureStorage2D(texture, levels, internal_format, width, height);
+            gl_ext.TextureSubImage2D(texture, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
+            gl_ext.GenerateTextureMipmap(texture);
+
+            // Set texture parameters.
+            gl_ext.TextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            gl_ext.TextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            gl_ext.TextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            gl_ext.TextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+            stbi_image_free(data);
+            return texture;
+        }
 
         // Generate texture.
-        glBindTexture(GL_TEXTURE_2D, texture);
+        gl_state.bind_texture(0, GL_TEXTURE_2D, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
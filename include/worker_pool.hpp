@@ -0,0 +1,125 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Threads kept alive between frames to run CPU work in parallel. Jobs must
+ * not call GL: the context is only current on the thread that created it.
+ */
+class WorkerPool
+{
+public:
+    // Zero starts one worker per hardware thread besides the caller's.
+    explicit WorkerPool(unsigned int num_threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Run every job, the calling thread included, and return once all have
+    // finished.
+    void run(const std::vector<std::function<void()>>& jobs_);
+
+    std::size_t size() const;
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+
+    // Jobs of the current run, the next one to claim and how many are left
+    // to finish. Guarded by `mutex`.
+    const std::vector<std::function<void()>>* jobs = nullptr;
+    std::size_t next_job = 0;
+    std::size_t jobs_left = 0;
+    bool stopping = false;
+
+    void worker();
+
+    // Claim and run one job. Returns false if none were left to claim.
+    bool run_next_job(std::unique_lock<std::mutex>& lock);
+};
+
+WorkerPool::WorkerPool(unsigned int num_threads)
+{
+    if (num_threads == 0)
+    {
+        unsigned int hardware_threads = std::thread::hardware_concurrency();
+        num_threads = hardware_threads > 1 ? hardware_threads - 1 : 0;
+    }
+
+    for (unsigned int i = 0; i < num_threads; i++)
+        threads.emplace_back(&WorkerPool::worker, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void WorkerPool::run(const std::vector<std::function<void()>>& jobs_)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs = &jobs_;
+    next_job = 0;
+    jobs_left = jobs_.size();
+    work_ready.notify_all();
+
+    while (run_next_job(lock))
+        ;
+
+    work_done.wait(lock, [this] { return jobs_left == 0; });
+    jobs = nullptr;
+}
+
+std::size_t WorkerPool::size() const
+{
+    return threads.size();
+}
+
+void WorkerPool::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        work_ready.wait(lock, [this] {
+            return stopping || (jobs && next_job < jobs->size());
+        });
+        if (stopping)
+            return;
+
+        run_next_job(lock);
+    }
+}
+
+bool WorkerPool::run_next_job(std::unique_lock<std::mutex>& lock)
+{
+    if (!jobs || next_job >= jobs->size())
+        return false;
+
+    const std::function<void()>& job = (*jobs)[next_job++];
+
+    lock.unlock();
+    job();
+    lock.lock();
+
+    if (--jobs_left == 0)
+        work_done.notify_all();
+    return true;
+}
+
+#endif /* WORKER_POOL_HPP */
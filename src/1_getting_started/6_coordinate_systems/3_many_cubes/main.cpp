@@ -1,3 +1,4 @@
+#include <cmath>
 #include <iostream>
 #include <filesystem>
 #include <string>
@@ -10,6 +11,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "instancing.hpp"
 #include "shader.hpp"
 
 constexpr std::size_t SCREEN_WIDTH = 800;
@@ -85,6 +87,10 @@ const std::vector<glm::vec3> cube_positions = {
     glm::vec3(-1.3f,  1.0f, -1.5f),
 };
 
+// Extra cubes laid out on a grid behind the others. Raise to stress test
+// instanced drawing, e.g. to 10000.
+constexpr std::size_t extra_cube_count = 0;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
@@ -151,7 +157,7 @@ int main()
     // Generate and bind a "vertex array object" (VAO) to store the VBO and
     // corresponding vertex attribute configurations.
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    gl_state.bind_vertex_array(VAO);
 
     // Send vertex data to the vertex shader. Do so by allocating GPU
     // memory, which is managed by "vertex buffer objects" (VBOs).
@@ -160,12 +166,12 @@ int main()
 
     // Bind VBO to the vertex buffer object, GL_ARRAY_BUFFER. Buffer
     // operations on GL_ARRAY_BUFFER then apply to VBO.
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
 
     // Bind EBO to the element buffer object, GL_ELEMENT_ARRAY_BUFFER. Buffer
     // operations on GL_ELEMENT_ARRAY_BUFFER then apply to EBO.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
 
     // Specify vertex data format.
@@ -175,8 +181,23 @@ int main()
     glEnableVertexAttribArray(1);
 
     // Can now unbind VAO and VBO, will rebind VAO as necessary in render loop.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+    gl_state.bind_vertex_array(0);
+
+    // Per-cube model matrices, so every cube is drawn with one call.
+    std::vector<glm::vec3> positions = cube_positions;
+    std::size_t grid_size = std::ceil(std::sqrt((float)extra_cube_count));
+    for (std::size_t i = 0; i < extra_cube_count; i++)
+    {
+        positions.push_back(glm::vec3(
+            2.0f * (i % grid_size) - grid_size,
+            2.0f * (i / grid_size) - grid_size,
+            -20.0f));
+    }
+
+    InstanceBuffer cube_instances;
+    cube_instances.init(VAO, 2);
+    std::vector<glm::mat4> cube_transforms(positions.size());
 
     /*
      * Create shader program.
@@ -286,19 +307,17 @@ int main()
 
         shader.use();
         shader.set_float("mix_val", mix_val);
-        shader.set_mat4fv("model", model);
         shader.set_mat4fv("view", view);
         shader.set_mat4fv("projection", projection);
-        glBindVertexArray(VAO);
-        for (unsigned int i = 0; i < cube_positions.size(); i++)
+        for (std::size_t i = 0; i < positions.size(); i++)
         {
             model = glm::mat4(1.0f);
-            model = glm::translate(model, cube_positions[i]);
+            model = glm::translate(model, positions[i]);
             model = glm::rotate(model, (float)glfwGetTime() * glm::radians(70 + (20.0f * i)), glm::vec3(0.5f, 1.0f, 0.0f));
-            shader.set_mat4fv("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            cube_transforms[i] = model;
         }
-        glBindVertexArray(0);
+        cube_instances.update(cube_transforms);
+        cube_instances.draw_arrays(GL_TRIANGLES, 0, 36);
 
         /*
          * Swap buffers and poll I/O events.
@@ -310,6 +329,10 @@ int main()
     /*
      * Clean up.
      */
+    cube_instances.deinit();
+    gl_state.forget_vertex_array(VAO);
+    gl_state.forget_buffer(VBO);
+    gl_state.forget_buffer(EBO);
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
@@ -2,15 +2,15 @@
 
 layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec2 in_tex_coords;
+layout (location = 2) in mat4 in_model;
 
 out vec2 vert_tex_coords;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(in_pos, 1.0f);
+    gl_Position = projection * view * in_model * vec4(in_pos, 1.0f);
     vert_tex_coords = in_tex_coords;
 }
@@ -3,8 +3,8 @@
 layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec2 in_tex_coords;
+layout (location = 3) in mat4 in_model;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -14,8 +14,8 @@ out vec2 tex_coords;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(in_pos, 1.0f);
-    frag_pos = vec3(model * vec4(in_pos, 1.0f));
-    normal_vec = mat3(transpose(inverse(model))) * in_normal;
+    gl_Position = projection * view * in_model * vec4(in_pos, 1.0f);
+    frag_pos = vec3(in_model * vec4(in_pos, 1.0f));
+    normal_vec = mat3(transpose(inverse(in_model))) * in_normal;
     tex_coords = in_tex_coords;
 }
@@ -10,6 +10,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "instancing.hpp"
 #include "shader.hpp"
 
 constexpr std::size_t SCREEN_WIDTH = 800;
@@ -290,14 +291,14 @@ int main()
     unsigned int cubeVAO;
     unsigned int VBO;
     glGenVertexArrays(1, &cubeVAO);
-    glBindVertexArray(cubeVAO);
+    gl_state.bind_vertex_array(cubeVAO);
 
     // Send vertex data to the vertex shader. Do so by allocating GPU memory,
     // which is managed by "vertex buffer objects" (VBOs). Bind VBO to the
     // vertex buffer object, GL_ARRAY_BUFFER. Buffer operations on
     // GL_ARRAY_BUFFER then apply to VBO.
     glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, VBO);
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
     // Cube position attribute.
@@ -310,12 +311,28 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
+    // The boxes never move, so upload their model matrices once and draw
+    // them all with one call.
+    std::vector<glm::mat4> cube_transforms;
+    for (std::size_t i = 0; i < cube_positions.size(); i++)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, cube_positions[i]);
+        float angle = 20.0f * i;
+        model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+        cube_transforms.push_back(model);
+    }
+
+    InstanceBuffer cube_instances;
+    cube_instances.init(cubeVAO, 3);
+    cube_instances.update(cube_transforms, GL_STATIC_DRAW);
+
     // Configure light VAO.
     unsigned int lightVAO;
     glGenVertexArrays(1, &lightVAO);
-    glBindVertexArray(lightVAO);
+    gl_state.bind_vertex_array(lightVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, VBO);
     // Light position attribute.
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -426,16 +443,7 @@ int main()
         glBindTexture(GL_TEXTURE_2D, box_specular_texture);
 
         // Render cubes.
-        glBindVertexArray(cubeVAO);
-        for (std::size_t i = 0; i < cube_positions.size(); i++)
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cube_positions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            box_shader.set_mat4fv("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
+        cube_instances.draw_arrays(GL_TRIANGLES, 0, 36);
 
         /*
          * Draw point lights.
@@ -455,7 +463,7 @@ int main()
             model = glm::scale(model, glm::vec3(0.2f));
             plight_shader.set_mat4fv("model", model);
             plight_shader.set_vec3("color", point_light_colors[i]);
-            glBindVertexArray(lightVAO);
+            gl_state.bind_vertex_array(lightVAO);
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
@@ -469,6 +477,10 @@ int main()
     /*
      * Clean up.
      */
+    cube_instances.deinit();
+    gl_state.forget_vertex_array(cubeVAO);
+    gl_state.forget_vertex_array(lightVAO);
+    gl_state.forget_buffer(VBO);
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &lightVAO);
     glDeleteBuffers(1, &VBO);
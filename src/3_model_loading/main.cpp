@@ -1,6 +1,8 @@
+#include <array>
 #include <cassert>
 #include <iostream>
 #include <filesystem>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -15,11 +17,18 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "frame.hpp"
+#include "gl_profiler.hpp"
 #include "mesh.hpp"
 #include "model.hpp"
 #include "lights.hpp"
+#include "render_queue.hpp"
+#include "ring_buffer.hpp"
 #include "room.hpp"
 #include "shader.hpp"
+#include "shader_variants.hpp"
+#include "shader_watcher.hpp"
+#include "worker_pool.hpp"
 
 constexpr float SCREEN_WIDTH = 800.0f;
 constexpr float SCREEN_HEIGHT = 600.0f;
@@ -29,12 +38,24 @@ ModelSettings drone("drone", false, 0.002f);
 
 ModelSettings model_settings = drone;
 bool show_mesh = false;
+bool use_shader_cache = true;
+bool use_spirv_shaders = false;  // Needs a build with -DSPIRV_SHADERS=ON.
+bool watch_shaders = true;
+bool use_shader_lod = true;
+bool multi_draw_model_meshes = true;
+bool print_gl_state_stats = false;
+bool print_cull_stats = false;
+bool record_on_workers = true;
+bool profile_gl_calls = false;  // Also writes gl_calls.csv.
 
 float room_scale_factor = 24.0f;
 
 namespace fs = std::filesystem;
 const fs::path shader_path = "src/3_model_loading";
 const fs::path texture_path = "assets/textures";
+const fs::path shader_cache_path = "build/shader_cache";
+const fs::path spirv_path = "build/spirv";
+const fs::path common_shader_path = "src/common";
 
 const fs::path plight_vshader_path = shader_path / "point_light.vs";
 const fs::path plight_fshader_path = shader_path / "point_light.fs";
@@ -129,6 +150,14 @@ glm::vec3 spotlight_direction = camera_front;
 const float spotlight_inner_cutoff = 12.5f;  // Degrees
 const float spotlight_outer_cutoff = 17.5f;  // Degrees
 
+// Lights that contribute to shading. Disabled lights are left out of the
+// scene, which also drops them from the compiled shader variant.
+bool enable_directional_light = false;
+bool enable_spotlight = false;
+
+// Distances and screen sizes at which the model switches to cheaper lighting.
+ShaderLodThresholds lod_thresholds;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
@@ -245,6 +274,21 @@ int main()
         return -1;
     }
 
+    /*
+     * Load OpenGL extensions and cache program binaries between runs.
+     */
+    load_gl_extensions((GLADloadproc)glfwGetProcAddress);
+    if (profile_gl_calls)
+    {
+        gl_profiler.install();
+        gl_profiler.open_csv("gl_calls.csv");
+    }
+    if (use_shader_cache)
+        Shader::enable_binary_cache(shader_cache_path);
+    if (use_spirv_shaders)
+        Shader::enable_spirv(spirv_path);
+    ShaderPreprocessor::add_include_directory(common_shader_path);
+
     /*
      * Set global OpenGL state.
      */
@@ -253,10 +297,12 @@ int main()
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     /*
-     * Create shader programs.
+     * Create shader programs. They compile in the background while the
+     * rest of the scene loads.
      */
-    auto plight_shader = std::make_unique<Shader>(plight_vshader_path.string(), plight_fshader_path.string());
-    auto main_shader = std::make_unique<Shader>(main_vshader_path.string(), main_fshader_path.string());
+    ShaderBatch shader_batch;
+    auto plight_shader = shader_batch.add(plight_vshader_path.string(), plight_fshader_path.string());
+    auto main_variants = std::make_unique<ShaderVariants>(main_vshader_path.string(), main_fshader_path.string());
 
     /*
      * Initialize lights.
@@ -283,7 +329,6 @@ int main()
             light_attenuation_constant,
             light_attenuation_linear,
             light_attenuation_quadratic);
-        point_light->init();
         point_lights.push_back(point_light);
     }
 
@@ -302,9 +347,19 @@ int main()
 
     // Scene lighting.
     auto scene_lighting = std::make_unique<SceneLighting>(
-        directional_light.get(),
+        enable_directional_light ? directional_light.get() : nullptr,
         point_lights,
-        spotlight.get());
+        enable_spotlight ? spotlight.get() : nullptr);
+    scene_lighting->init();
+
+    // Uniform blocks written every frame, with room to spare.
+    RingBuffer uniform_ring;
+    uniform_ring.init(GL_UNIFORM_BUFFER, 16 * 1024);
+
+    // Queue the main shader variants the scene starts with.
+    ShaderFeatures initial_features = features_from_lighting(*scene_lighting);
+    for (ShaderLod lod : {ShaderLod::FULL, ShaderLod::REDUCED, ShaderLod::MINIMAL})
+        main_variants->precompile(shader_batch, apply_shader_lod(initial_features, lod));
 
     /*
      * Initialize room.
@@ -315,7 +370,6 @@ int main()
         ceiling_specular_path,
         wall_diffuse_path,
         wall_specular_path,
-        scene_lighting.get(),
         room_scale_factor);
     room.init();
 
@@ -323,9 +377,27 @@ int main()
      * Initialize model.
      */
     Model model_object(model_obj_path,
-        model_settings.flip_textures,
-        scene_lighting.get());
+        model_settings.flip_textures);
     model_object.init();
+    model_object.set_multi_draw(multi_draw_model_meshes);
+
+    // Wait for any shader programs still compiling.
+    shader_batch.finish();
+
+    // Reload shaders when their source files are edited.
+    ShaderWatcher shader_watcher;
+    if (watch_shaders)
+    {
+        shader_watcher.watch(plight_shader.get());
+        shader_watcher.watch(main_variants.get());
+    }
+
+    // Draws of the current frame.
+    RenderQueue render_queue;
+
+    // Threads recording parts of the scene, one list each.
+    WorkerPool worker_pool;
+    std::array<RenderQueue, 2> scene_lists;
 
     /*
      * Render loop.
@@ -341,9 +413,16 @@ int main()
          */
         process_input(window);
 
+        // Swap in any reloaded shaders.
+        shader_watcher.poll();
+
         // Update spotlight based on camera movement.
         spotlight->update(camera_pos, camera_front);
 
+        // Write this frame's uniform blocks to the next section of the ring.
+        uniform_ring.begin_frame();
+        scene_lighting->update(uniform_ring);
+
         /*
          * Render.
          */
@@ -351,74 +430,106 @@ int main()
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Initial MVP matrix definitions.
-        glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 view = glm::mat4(1.0f);
-        glm::mat4 projection = glm::mat4(1.0f);
-
         // Set view and projection matrices.
-        view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
-        projection = glm::perspective(glm::radians(fov), SCREEN_WIDTH / SCREEN_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
+        glm::mat4 projection = glm::perspective(glm::radians(fov), SCREEN_WIDTH / SCREEN_HEIGHT, 0.1f, 100.0f);
+
+        // Camera matrices for every program.
+        FrameStd140 frame_block{};
+        frame_block.projection = projection;
+        frame_block.view = view;
+        frame_block.view_pos = camera_pos;
+        uniform_ring.bind(FRAME_BLOCK_BINDING, &frame_block, sizeof(FrameStd140));
 
         /*
-         * Draw point lights.
+         * Pick programs.
          */
-        plight_shader->use();
-
-        // Set MVP matrices.
-        plight_shader->set_mat4fv("projection", projection);
-        plight_shader->set_mat4fv("view", view);
-
-        // Render point light.
-        for (auto& point_light : point_lights)
+        // Pick the main shader variant specialized for the current scene.
+        ShaderFeatures features = features_from_lighting(*scene_lighting);
+        Shader* main_shader = main_variants->get(features);
+
+        // Light the model with a cheaper variant when it is far away or small
+        // on screen.
+        ShaderLod model_lod = ShaderLod::FULL;
+        if (use_shader_lod)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, point_light->position);
-            model = glm::scale(model, glm::vec3(point_light->scale_factor));
-            plight_shader->set_mat4fv("model", model);
-            plight_shader->set_vec3("color", point_light->color);
-            point_light->draw();
+            model_lod = select_shader_lod(lod_thresholds,
+                model_object.get_bounding_center() * model_settings.scale_factor,
+                model_object.get_bounding_radius() * model_settings.scale_factor,
+                camera_pos,
+                fov);
         }
+        Shader* model_shader = main_variants->get(apply_shader_lod(features, model_lod));
 
         /*
-         * Draw floor.
+         * Queue and draw the frame.
          */
-        main_shader->use();
+        render_queue.clear();
+        render_queue.set_view(RenderPass::OPAQUE, camera_pos, 100.0f);
+        render_queue.set_frustum(RenderPass::OPAQUE, projection * view);
+
+        // Record the floor and the model in parallel, each into its own
+        // list, then append the lists in order.
+        for (auto& list : scene_lists)
+            render_queue.prepare_list(list);
+
+        std::vector<std::function<void()>> record_jobs = {
+            // Floor.
+            [&] {
+                room.submit(scene_lists[0], RenderPass::OPAQUE, main_shader);
+            },
+            // Model.
+            [&] {
+                glm::mat4 model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(0.0f));
+                model = glm::scale(model, glm::vec3(model_settings.scale_factor));
+                model_object.submit(scene_lists[1], RenderPass::OPAQUE, model_shader, model);
+            },
+        };
+
+        if (record_on_workers)
+        {
+            worker_pool.run(record_jobs);
+        }
+        else
+        {
+            for (const auto& job : record_jobs)
+                job();
+        }
 
-        // Position properties.
-        main_shader->set_vec3("view_pos", camera_pos);
+        for (auto& list : scene_lists)
+            render_queue.append(list);
 
-        // Material properties.
-        main_shader->set_float("material.shininess", 32.0f);
+        // Point lights. Their instances are uploaded, so they are queued on
+        // the GL thread.
+        scene_lighting->submit_markers(render_queue, RenderPass::OPAQUE, plight_shader.get());
 
-        // Set view and projection matrices,
-        main_shader->set_mat4fv("projection", projection);
-        main_shader->set_mat4fv("view", view);
+        render_queue.execute(RenderPass::OPAQUE);
 
-        room.draw(main_shader.get());
+        // The GPU may still be reading this frame's uniform blocks.
+        uniform_ring.end_frame();
 
         /*
-         * Draw model.
+         * Report binds dropped by the GL state cache.
          */
-        main_shader->use();
-
-        // Set model matrix.
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f));
-        model = glm::scale(model, glm::vec3(model_settings.scale_factor));
-
-        // Position properties.
-        main_shader->set_vec3("view_pos", camera_pos);
-
-        // Material properties.
-        main_shader->set_float("material.shininess", 32.0f);
+        GLStateStats gl_state_stats = gl_state.end_frame();
+        if (print_gl_state_stats)
+        {
+            std::cout << "GL binds: " << gl_state_stats.issued << " issued, "
+                << gl_state_stats.suppressed << " suppressed\n";
+        }
 
-        // Render backpack.
-        main_shader->set_mat4fv("projection", projection);
-        main_shader->set_mat4fv("view", view);
-        main_shader->set_mat4fv("model", model);
+        // Report meshes culled this frame.
+        if (print_cull_stats)
+        {
+            CullStats cull_stats = render_queue.get_cull_stats(RenderPass::OPAQUE);
+            std::cout << "Meshes culled: " << cull_stats.culled << " of "
+                << cull_stats.visible + cull_stats.culled << '\n';
+        }
 
-        model_object.draw(main_shader.get());
+        // Report GL calls made this frame.
+        if (profile_gl_calls)
+            gl_profiler.end_frame().print(std::cout);
 
         /*
          * Swap buffers and poll I/O events.
@@ -431,9 +542,9 @@ int main()
      * Clean up.
      */
     model_object.deinit();
-    for (auto& point_light : point_lights)
-        point_light->deinit();
     room.deinit();
+    scene_lighting->deinit();
+    uniform_ring.deinit();
 
     glfwTerminate();
     return 0;
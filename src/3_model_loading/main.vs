@@ -5,8 +5,8 @@ layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec2 in_tex_coords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+#include "frame.glsl"
 
 out vec3 frag_pos;
 out vec3 normal_vec;
@@ -1,12 +1,16 @@
 #version 330 core
 
 layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec4 in_position_scale;
+layout (location = 2) in vec3 in_color;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+out vec3 vert_color;
+
+#include "frame.glsl"
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(in_pos, 1.0f);
+    vec3 world_pos = in_pos * in_position_scale.w + in_position_scale.xyz;
+    gl_Position = projection * view * vec4(world_pos, 1.0f);
+    vert_color = in_color;
 }
@@ -0,0 +1,16 @@
+#version 330 core
+
+layout (location = 0) in vec3 in_pos;
+
+#include "frame.glsl"
+
+uniform mat4 model;
+
+// Depth prepass. Must produce exactly the depth main.vs does, so the
+// position is computed the same way with no branch around it.
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(in_pos, 1.0f);
+}
@@ -1,8 +1,10 @@
 #undef NDEBUG
 
+#include <array>
 #include <cassert>
 #include <iostream>
 #include <filesystem>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -17,12 +19,19 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "frame.hpp"
+#include "gl_profiler.hpp"
 #include "mesh.hpp"
 #include "model.hpp"
 #include "lights.hpp"
 #include "quad.hpp"
+#include "render_queue.hpp"
+#include "ring_buffer.hpp"
 #include "room.hpp"
 #include "shader.hpp"
+#include "shader_variants.hpp"
+#include "shader_watcher.hpp"
+#include "worker_pool.hpp"
 
 constexpr float SCREEN_WIDTH = 800.0f;
 constexpr float SCREEN_HEIGHT = 600.0f;
@@ -32,12 +41,24 @@ ModelSettings drone("drone", false, 0.002f);
 
 ModelSettings model_settings = drone;
 bool show_mesh = false;
+bool use_shader_cache = true;
+bool use_spirv_shaders = false;  // Needs a build with -DSPIRV_SHADERS=ON.
+bool watch_shaders = true;
+bool use_shader_lod = true;
+bool multi_draw_model_meshes = true;
+bool print_gl_state_stats = false;
+bool print_cull_stats = false;
+bool record_on_workers = true;
+bool profile_gl_calls = false;  // Also writes gl_calls.csv.
 
 float room_scale_factor = 24.0f;
 
 namespace fs = std::filesystem;
 const fs::path shader_path = "src/4_advanced_opengl/11_anti_aliasing";
 const fs::path texture_path = "assets/textures";
+const fs::path shader_cache_path = "build/shader_cache";
+const fs::path spirv_path = "build/spirv";
+const fs::path common_shader_path = "src/common";
 
 const fs::path plight_vshader_path = shader_path / "point_light.vs";
 const fs::path plight_fshader_path = shader_path / "point_light.fs";
@@ -45,6 +66,7 @@ const fs::path main_vshader_path = shader_path / "main.vs";
 const fs::path main_fshader_path = shader_path / "main.fs";
 const fs::path shadow_vshader_path = shader_path / "shadow_depth.vs";
 const fs::path shadow_fshader_path = shader_path / "shadow_depth.fs";
+const fs::path camera_depth_vshader_path = shader_path / "camera_depth.vs";
 const fs::path quad_vshader_path = shader_path / "quad.vs";
 const fs::path quad_fshader_path = shader_path / "quad.fs";
 
@@ -85,6 +107,11 @@ float fov = 45.0f;
 
 glm::vec3 model_pos(0.0f, 0.0f, 0.0f);
 
+// Lay down depth before lighting, so each visible pixel is shaded once.
+// Toggled with P.
+bool depth_prepass = true;
+bool depth_prepass_key_down = false;
+
 bool anti_aliasing_toggle = true;
 
 /*
@@ -142,6 +169,14 @@ glm::vec3 spotlight_direction = camera_front;
 const float spotlight_inner_cutoff = 12.5f;  // Degrees
 const float spotlight_outer_cutoff = 17.5f;  // Degrees
 
+// Lights that contribute to shading. Disabled lights are left out of the
+// scene, which also drops them from the compiled shader variant.
+bool enable_directional_light = false;
+bool enable_spotlight = false;
+
+// Distances and screen sizes at which the model switches to cheaper lighting.
+ShaderLodThresholds lod_thresholds;
+
 /*
  * Shadow settings.
  */
@@ -149,6 +184,9 @@ const float spotlight_outer_cutoff = 17.5f;  // Degrees
 const std::size_t shadow_width = 4096;
 const std::size_t shadow_height = 4096;
 
+// PCF kernel radius in texels. Zero takes a single shadow map sample.
+const unsigned int shadow_pcf_radius = 2;
+
 // Light frustum settings.
 float light_frustum_near_plane = 0.1f;
 float light_frustum_far_plane = 30.0f;
@@ -190,6 +228,11 @@ std::unique_ptr<Room> room;
  */
 std::unique_ptr<Model> model_object;
 
+/*
+ * Draws of the current frame.
+ */
+RenderQueue render_queue;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
@@ -239,6 +282,15 @@ void process_input(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
         model_pos.y -= camera_speed * 1.0f;
 
+    // Toggle the depth prepass.
+    bool prepass_key_down = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (prepass_key_down && !depth_prepass_key_down)
+    {
+        depth_prepass = !depth_prepass;
+        std::cout << "Depth prepass " << (depth_prepass ? "on" : "off") << '\n';
+    }
+    depth_prepass_key_down = prepass_key_down;
+
     // Toggle anti-aliasing.
     if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
         anti_aliasing_toggle = false;
@@ -288,53 +340,31 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
         fov = 45.0f;
 }
 
-void render_scene(Shader* shader)
+// Queue the room. Safe to call from worker threads.
+void submit_room(RenderQueue& queue, RenderPass pass, Shader* shader)
 {
-    if (!shader)
+    if (!room)
     {
-        std::cerr << "main::render_scene: shader is NULL\n";
+        std::cerr << "main::submit_room: room is NULL\n";
         return;
     }
-    /*
-     * Draw room.
-     */
-    shader->use();
-
-    // Position properties.
-    shader->set_vec3("view_pos", camera_pos);
-
-    // Material properties.
-    shader->set_float("material.shininess", 32.0f);
+    room->submit(queue, pass, shader);
+}
 
-    // Render room.
-    if (!room)
+// Queue the model, possibly with a cheaper variant of the room's shader.
+// Safe to call from worker threads.
+void submit_model(RenderQueue& queue, RenderPass pass, Shader* shader)
+{
+    if (!model_object)
     {
-        std::cerr << "main::render_scene: room is NULL\n";
+        std::cerr << "main::submit_model: model_object is NULL\n";
         return;
     }
-    room->draw(shader);
-
-    /*
-     * Draw model.
-     */
-    shader->use();
-
-    // Position properties.
-    shader->set_vec3("view_pos", camera_pos);
 
-    // Set model matrix.
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, model_pos);
     model = glm::scale(model, glm::vec3(model_settings.scale_factor));
-    shader->set_mat4fv("model", model);
-
-    // Render model.
-    if (!model_object)
-    {
-        std::cerr << "main::render_scene: model_object is NULL\n";
-        return;
-    }
-    model_object->draw(shader);
+    model_object->submit(queue, pass, shader, model);
 }
 
 int main()
@@ -373,6 +403,21 @@ int main()
         return -1;
     }
 
+    /*
+     * Load OpenGL extensions and cache program binaries between runs.
+     */
+    load_gl_extensions((GLADloadproc)glfwGetProcAddress);
+    if (profile_gl_calls)
+    {
+        gl_profiler.install();
+        gl_profiler.open_csv("gl_calls.csv");
+    }
+    if (use_shader_cache)
+        Shader::enable_binary_cache(shader_cache_path);
+    if (use_spirv_shaders)
+        Shader::enable_spirv(spirv_path);
+    ShaderPreprocessor::add_include_directory(common_shader_path);
+
     /*
      * Set global OpenGL state.
      */
@@ -391,7 +436,7 @@ int main()
     // Create texture for depth map.
     unsigned int depth_map;
     glGenTextures(1, &depth_map);
-    glBindTexture(GL_TEXTURE_2D, depth_map);
+    gl_state.bind_texture(0, GL_TEXTURE_2D, depth_map);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, shadow_width,
         shadow_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -400,7 +445,7 @@ int main()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     std::vector<float> border_color = { 1.0f, 1.0f, 1.0f, 1.0f };
     glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border_color.data());
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl_state.bind_texture(0, GL_TEXTURE_2D, 0);
 
     // Attach depth texture as framebuffer's depth buffer.
     glBindFramebuffer(GL_FRAMEBUFFER, depth_map_fbo);
@@ -412,12 +457,16 @@ int main()
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     /*
-     * Create shader programs.
+     * Create shader programs. They compile in the background while the
+     * rest of the scene loads.
      */
-    auto plight_shader = std::make_unique<Shader>(plight_vshader_path.string(), plight_fshader_path.string());
-    auto main_shader = std::make_unique<Shader>(main_vshader_path.string(), main_fshader_path.string());
-    auto shadow_shader = std::make_unique<Shader>(shadow_vshader_path.string(), shadow_fshader_path.string());
-    auto quad_shader = std::make_unique<Shader>(quad_vshader_path.string(), quad_fshader_path.string());
+    ShaderBatch shader_batch;
+    auto plight_shader = shader_batch.add(plight_vshader_path.string(), plight_fshader_path.string());
+    auto main_variants = std::make_unique<ShaderVariants>(main_vshader_path.string(), main_fshader_path.string());
+    auto shadow_shader = shader_batch.add(shadow_vshader_path.string(), shadow_fshader_path.string());
+    auto camera_depth_shader = shader_batch.add(camera_depth_vshader_path.string(),
+        shadow_fshader_path.string());
+    auto quad_shader = shader_batch.add(quad_vshader_path.string(), quad_fshader_path.string());
 
     /*
      * Initialize lights.
@@ -443,7 +492,6 @@ int main()
             light_attenuation_constant,
             light_attenuation_linear,
             light_attenuation_quadratic);
-        point_light->init();
         point_lights.push_back(point_light);
     }
 
@@ -462,9 +510,28 @@ int main()
 
     // Scene lighting.
     scene_lighting = std::make_unique<SceneLighting>(
-        directional_light.get(),
+        enable_directional_light ? directional_light.get() : nullptr,
         point_lights,
-        spotlight.get());
+        enable_spotlight ? spotlight.get() : nullptr);
+    scene_lighting->init();
+
+    // Uniform blocks written every frame, with room to spare.
+    RingBuffer uniform_ring;
+    uniform_ring.init(GL_UNIFORM_BUFFER, 16 * 1024);
+
+    // Threads recording parts of the scene, one list each.
+    WorkerPool worker_pool;
+    std::array<RenderQueue, 2> scene_lists;
+
+    // Queue the main shader variants the scene starts with.
+    ShaderFeatures initial_features = features_from_lighting(*scene_lighting);
+    initial_features.shadows = true;
+    for (unsigned int pcf_radius : {0u, shadow_pcf_radius})
+    {
+        initial_features.pcf_radius = pcf_radius;
+        for (ShaderLod lod : {ShaderLod::FULL, ShaderLod::REDUCED, ShaderLod::MINIMAL})
+            main_variants->precompile(shader_batch, apply_shader_lod(initial_features, lod));
+    }
 
     /*
      * Initialize room.
@@ -475,7 +542,6 @@ int main()
         ceiling_specular_path,
         wall_diffuse_path,
         wall_specular_path,
-        scene_lighting.get(),
         room_scale_factor);
     room->init();
 
@@ -483,9 +549,9 @@ int main()
      * Initialize model.
      */
     model_object = std::make_unique<Model>(model_obj_path,
-        model_settings.flip_textures,
-        scene_lighting.get());
+        model_settings.flip_textures);
     model_object->init();
+    model_object->set_multi_draw(multi_draw_model_meshes);
 
     /*
      * Initialize quad. TODO for testing only.
@@ -493,6 +559,20 @@ int main()
     quad = std::make_unique<Quad>();
     quad->init();
 
+    // Wait for any shader programs still compiling.
+    shader_batch.finish();
+
+    // Reload shaders when their source files are edited.
+    ShaderWatcher shader_watcher;
+    if (watch_shaders)
+    {
+        shader_watcher.watch(plight_shader.get());
+        shader_watcher.watch(main_variants.get());
+        shader_watcher.watch(shadow_shader.get());
+        shader_watcher.watch(camera_depth_shader.get());
+        shader_watcher.watch(quad_shader.get());
+    }
+
     /*
      * Render loop.
      */
@@ -502,32 +582,52 @@ int main()
         delta_time = current_frame - last_frame;
         last_frame = current_frame;
 
-        // Toggle anti-aliasing.
+        // Toggle anti-aliasing. Smooth shadows come from the PCF variant of
+        // the main shader.
         if (anti_aliasing_toggle)
-        {
-            // Enable AA.
             glEnable(GL_MULTISAMPLE);
-            main_shader->use();
-            main_shader->set_bool("smooth_shadows", true);
-        }
         else
-        {
-            // Disable AA.
             glDisable(GL_MULTISAMPLE);
-            main_shader->use();
-            main_shader->set_bool("smooth_shadows", false);
-        }
 
         /*
          * Input.
          */
         process_input(window);
 
+        // Swap in any reloaded shaders.
+        shader_watcher.poll();
+
         // Update spotlight based on camera movement.
         spotlight->update(camera_pos, camera_front);
 
+        // Write this frame's uniform blocks to the next section of the ring.
+        uniform_ring.begin_frame();
+        scene_lighting->update(uniform_ring);
+
+        /*
+         * Pick programs.
+         */
+        // Pick the main shader variant specialized for the current scene.
+        ShaderFeatures features = features_from_lighting(*scene_lighting);
+        features.shadows = true;
+        features.pcf_radius = anti_aliasing_toggle ? shadow_pcf_radius : 0;
+        Shader* main_shader = main_variants->get(features);
+
+        // Light the model with a cheaper variant when it is far away or small
+        // on screen.
+        ShaderLod model_lod = ShaderLod::FULL;
+        if (use_shader_lod)
+        {
+            model_lod = select_shader_lod(lod_thresholds,
+                model_pos + model_object->get_bounding_center() * model_settings.scale_factor,
+                model_object->get_bounding_radius() * model_settings.scale_factor,
+                camera_pos,
+                fov);
+        }
+        Shader* model_shader = main_variants->get(apply_shader_lod(features, model_lod));
+
         /*
-         * Generate depth buffer for shadows.
+         * Render depth buffer for shadows.
          */
         // Set up light perspective matrix. This part is a bit of a hack since
         // we're pretending a point light is a directional light (by using a
@@ -538,9 +638,74 @@ int main()
             point_light_positions[0], model_pos, glm::vec3(0.0f, 1.0f, 0.0f));
         glm::mat4 light_space_matrix = light_projection * light_view;
 
-        // Pass uniforms to shader.
-        shadow_shader->use();
-        shadow_shader->set_mat4fv("light_space_matrix", light_space_matrix);
+        // Set view and projection matrices. Model matrix set per draw by the
+        // render queue.
+        glm::mat4 view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
+        glm::mat4 projection = glm::perspective(glm::radians(fov), SCREEN_WIDTH / SCREEN_HEIGHT, 0.1f, 100.0f);
+
+        // Camera and light matrices for every program.
+        FrameStd140 frame_block{};
+        frame_block.projection = projection;
+        frame_block.view = view;
+        frame_block.light_space_matrix = light_space_matrix;
+        frame_block.view_pos = camera_pos;
+        uniform_ring.bind(FRAME_BLOCK_BINDING, &frame_block, sizeof(FrameStd140));
+
+        /*
+         * Queue the frame. Each pass is sorted and drawn as a whole.
+         */
+        // Pass depth map to objects, to render shadows.
+        room->set_depth_map(depth_map);
+        model_object->set_depth_map(depth_map);
+
+        render_queue.clear();
+        render_queue.set_view(RenderPass::SHADOW, point_light_positions[0], light_frustum_far_plane);
+        render_queue.set_view(RenderPass::DEPTH, camera_pos, 100.0f);
+        render_queue.set_view(RenderPass::OPAQUE, camera_pos, 100.0f);
+        render_queue.set_view(RenderPass::UNLIT, camera_pos, 100.0f);
+
+        // Skip meshes the light or the camera cannot see.
+        render_queue.set_frustum(RenderPass::SHADOW, light_space_matrix);
+        render_queue.set_frustum(RenderPass::DEPTH, projection * view);
+        render_queue.set_frustum(RenderPass::OPAQUE, projection * view);
+
+        // Record the room and the model in parallel, each into its own list,
+        // then append the lists in order. Light markers upload their
+        // instances, so they are queued here on the GL thread.
+        for (auto& list : scene_lists)
+            render_queue.prepare_list(list);
+
+        std::vector<std::function<void()>> record_jobs = {
+            [&] {
+                submit_room(scene_lists[0], RenderPass::SHADOW, shadow_shader.get());
+                if (depth_prepass)
+                    submit_room(scene_lists[0], RenderPass::DEPTH, camera_depth_shader.get());
+                submit_room(scene_lists[0], RenderPass::OPAQUE, main_shader);
+            },
+            [&] {
+                submit_model(scene_lists[1], RenderPass::SHADOW, shadow_shader.get());
+                if (depth_prepass)
+                    submit_model(scene_lists[1], RenderPass::DEPTH, camera_depth_shader.get());
+                submit_model(scene_lists[1], RenderPass::OPAQUE, model_shader);
+            },
+        };
+
+        if (record_on_workers)
+        {
+            worker_pool.run(record_jobs);
+        }
+        else
+        {
+            for (const auto& job : record_jobs)
+                job();
+        }
+
+        for (auto& list : scene_lists)
+            render_queue.append(list);
+
+        // Markers are not in the depth prepass, so they get their own pass
+        // drawn with depth writes on.
+        scene_lighting->submit_markers(render_queue, RenderPass::UNLIT, plight_shader.get());
 
         glViewport(0, 0, shadow_width, shadow_height);
         glBindFramebuffer(GL_FRAMEBUFFER, depth_map_fbo);
@@ -549,15 +714,10 @@ int main()
         // Render scene to shadow map. Cull front faces during to eliminate
         // potential peter panning.
         glCullFace(GL_FRONT);
-        render_scene(shadow_shader.get());
+        render_queue.execute(RenderPass::SHADOW);
         glCullFace(GL_BACK);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        /*
-         * Render.
-         */
-        main_shader->use();
-
         // Reset viewport.
         glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 
@@ -565,50 +725,31 @@ int main()
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Initial projection and view matrix definitions.
-        glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 view = glm::mat4(1.0f);
-        glm::mat4 projection = glm::mat4(1.0f);
-
-        // Set view and projection matrices. Model matrix set per object in
-        // render_scene function.
-        view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
-        projection = glm::perspective(glm::radians(fov), SCREEN_WIDTH / SCREEN_HEIGHT, 0.1f, 100.0f);
-
-        // Assign projection and view matrices.
-        main_shader->set_mat4fv("projection", projection);
-        main_shader->set_mat4fv("view", view);
-
-        // Pass light space matrix to main shader.
-        main_shader->set_mat4fv("light_space_matrix", light_space_matrix);
+        // Depth prepass, sharing the shadow pass's fragment shader. The
+        // lighting pass then only shades fragments matching the nearest
+        // depth, without writing depth itself.
+        if (depth_prepass)
+        {
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            render_queue.execute(RenderPass::DEPTH);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-        // Pass depth map to objects, to render shadows.
-        room->set_depth_map(depth_map);
-        model_object->set_depth_map(depth_map);
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+        }
 
         // Render scene normally.
-        render_scene(main_shader.get());
-
-        /*
-         * Draw point lights.
-         */
-        plight_shader->use();
-
-        // Set MVP matrices.
-        plight_shader->set_mat4fv("projection", projection);
-        plight_shader->set_mat4fv("view", view);
+        render_queue.execute(RenderPass::OPAQUE);
 
-        // Render point light.
-        for (auto& point_light : point_lights)
+        if (depth_prepass)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, point_light->position);
-            model = glm::scale(model, glm::vec3(point_light->scale_factor));
-            plight_shader->set_mat4fv("model", model);
-            plight_shader->set_vec3("color", point_light->color);
-            point_light->draw();
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
         }
 
+        // Point lights.
+        render_queue.execute(RenderPass::UNLIT);
+
         // // Render quad. TODO for testing only.
         // quad_shader->use();
         // quad_shader->set_float("near_plane", light_frustum_near_plane);
@@ -616,6 +757,34 @@ int main()
         // quad->set_depth_map(depth_map);
         // quad->draw(quad_shader.get());
 
+        // The GPU may still be reading this frame's uniform blocks.
+        uniform_ring.end_frame();
+
+        /*
+         * Report binds dropped by the GL state cache.
+         */
+        GLStateStats gl_state_stats = gl_state.end_frame();
+        if (print_gl_state_stats)
+        {
+            std::cout << "GL binds: " << gl_state_stats.issued << " issued, "
+                << gl_state_stats.suppressed << " suppressed\n";
+        }
+
+        // Report meshes culled this frame.
+        if (print_cull_stats)
+        {
+            CullStats light_culling = render_queue.get_cull_stats(RenderPass::SHADOW);
+            CullStats camera_culling = render_queue.get_cull_stats(RenderPass::OPAQUE);
+            std::cout << "Meshes culled: light " << light_culling.culled << " of "
+                << light_culling.visible + light_culling.culled << ", camera "
+                << camera_culling.culled << " of "
+                << camera_culling.visible + camera_culling.culled << '\n';
+        }
+
+        // Report GL calls made this frame.
+        if (profile_gl_calls)
+            gl_profiler.end_frame().print(std::cout);
+
         /*
          * Swap buffers and poll I/O events.
          */
@@ -627,9 +796,9 @@ int main()
      * Clean up.
      */
     model_object->deinit();
-    for (auto& point_light : point_lights)
-        point_light->deinit();
     room->deinit();
+    scene_lighting->deinit();
+    uniform_ring.deinit();
 
     glfwTerminate();
     return 0;
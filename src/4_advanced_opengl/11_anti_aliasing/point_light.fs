@@ -2,9 +2,9 @@
 
 out vec4 frag_color;
 
-uniform vec3 color;
+in vec3 vert_color;
 
 void main()
 {
-    frag_color = vec4(color, 1.0f);
+    frag_color = vec4(vert_color, 1.0f);
 }
@@ -5,15 +5,17 @@ layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec2 in_tex_coords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 light_space_matrix;
+
+#include "frame.glsl"
 
 out vec3 frag_pos;
 out vec3 normal_vec;
 out vec2 tex_coords;
 out vec4 frag_pos_light_space;
 
+// Matches the depth prepass in camera_depth.vs.
+invariant gl_Position;
+
 void main()
 {
     gl_Position = projection * view * model * vec4(in_pos, 1.0f);
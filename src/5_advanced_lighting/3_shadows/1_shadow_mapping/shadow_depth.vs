@@ -2,7 +2,8 @@
 
 layout (location = 0) in vec3 in_pos;
 
-uniform mat4 light_space_matrix;
+#include "frame.glsl"
+
 uniform mat4 model;
 
 void main()
@@ -0,0 +1,40 @@
+// Feature switches of the lighting shaders. ShaderVariants injects them as
+// defines when compiling GLSL. SPIR-V builds declare them as specialization
+// constants instead, which Shader sets from the same defines when loading the
+// binary. Test them with plain if statements so both forms work; the compiler
+// folds the constant conditions either way.
+
+#ifdef GL_SPIRV
+layout (constant_id = 0) const int spec_num_point_lights = 1;
+layout (constant_id = 1) const int spec_enable_directional_light = 0;
+layout (constant_id = 2) const int spec_enable_spotlight = 0;
+layout (constant_id = 3) const int spec_enable_shadows = 0;
+layout (constant_id = 4) const int spec_shadow_pcf_radius = 0;
+layout (constant_id = 5) const int spec_enable_specular = 1;
+
+#define NUM_POINT_LIGHTS spec_num_point_lights
+#define ENABLE_DIRECTIONAL_LIGHT spec_enable_directional_light
+#define ENABLE_SPOTLIGHT spec_enable_spotlight
+#define ENABLE_SHADOWS spec_enable_shadows
+#define SHADOW_PCF_RADIUS spec_shadow_pcf_radius
+#define ENABLE_SPECULAR spec_enable_specular
+#else
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS 1
+#endif
+#ifndef ENABLE_DIRECTIONAL_LIGHT
+#define ENABLE_DIRECTIONAL_LIGHT 0
+#endif
+#ifndef ENABLE_SPOTLIGHT
+#define ENABLE_SPOTLIGHT 0
+#endif
+#ifndef ENABLE_SHADOWS
+#define ENABLE_SHADOWS 0
+#endif
+#ifndef SHADOW_PCF_RADIUS
+#define SHADOW_PCF_RADIUS 0
+#endif
+#ifndef ENABLE_SPECULAR
+#define ENABLE_SPECULAR 1
+#endif
+#endif
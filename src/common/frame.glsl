@@ -0,0 +1,17 @@
+// Camera and light matrices shared by every program, filled once per frame
+// from FrameStd140 in frame.hpp. SPIR-V programs cannot look the block up by
+// name, so the binding point from shader.hpp is given explicitly there. The
+// sources are #version 330, so the SPIR-V build enables the binding qualifier
+// with ARB_shading_language_420pack, see shader_expand --require.
+
+#ifdef GL_SPIRV
+layout (std140, binding = 1) uniform Frame
+#else
+layout (std140) uniform Frame
+#endif
+{
+    mat4 projection;
+    mat4 view;
+    mat4 light_space_matrix;
+    vec3 view_pos;
+};
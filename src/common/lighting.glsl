@@ -0,0 +1,183 @@
+// Phong lighting shared by the lighting targets. Include after declaring the
+// tex_coords input.
+
+#include "features.glsl"
+
+struct DirectionalLight
+{
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight
+{
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    // Attenuation parameters.
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct Spotlight
+{
+    vec3 position;
+    vec3 direction;
+    float inner_cutoff;
+    float outer_cutoff;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    // Attenuation parameters.
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct Material
+{
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    float shininess;
+};
+
+#define MAX_POINT_LIGHTS 16
+
+// Filled once per frame from SceneLighting. Keep MAX_POINT_LIGHTS in sync
+// with lights.hpp. SPIR-V programs cannot look the block up by name, so the
+// binding point from shader.hpp is given explicitly there, which the
+// SPIR-V build enables with ARB_shading_language_420pack.
+#ifdef GL_SPIRV
+layout (std140, binding = 0) uniform Lighting
+#else
+layout (std140) uniform Lighting
+#endif
+{
+    DirectionalLight dir_light;
+    Spotlight spotlight;
+    PointLight point_lights[MAX_POINT_LIGHTS];
+};
+
+uniform Material material;
+
+vec3 calc_dir_light(DirectionalLight light, vec3 normal, vec3 view_dir)
+{
+    // Ambient.
+    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, tex_coords));
+
+    // Diffuse.
+    vec3 light_dir = normalize(-light.direction);
+    float diff = max(dot(normal, light_dir), 0.0f);
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, tex_coords));
+
+    // Specular.
+    vec3 specular = vec3(0.0f);
+    if (ENABLE_SPECULAR != 0)
+    {
+        vec3 reflect_dir = reflect(-light_dir, normal);
+        float spec = pow(max(dot(view_dir, reflect_dir), 0.0f), material.shininess);
+        specular = light.specular * spec * vec3(texture(material.texture_specular1, tex_coords));
+    }
+
+    return (ambient + diffuse + specular);
+}
+
+vec3 calc_point_light(PointLight light, vec3 normal, vec3 frag_pos, vec3 view_dir, float shadow)
+{
+    // Ambient.
+    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, tex_coords));
+
+    // Diffuse.
+    vec3 light_dir = normalize(light.position - frag_pos);
+    float diff = max(dot(normal, light_dir), 0.0f);
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, tex_coords));
+
+    // Specular.
+    vec3 specular = vec3(0.0f);
+    if (ENABLE_SPECULAR != 0)
+    {
+        vec3 reflect_dir = reflect(-light_dir, normal);
+        float spec = pow(max(dot(view_dir, reflect_dir), 0.0f), material.shininess);
+        specular = light.specular * spec * vec3(texture(material.texture_specular1, tex_coords));
+    }
+
+    // Attenuation.
+    float distance = length(light.position - frag_pos);
+    float attenuation = 1.0f / (light.constant + \
+                               (light.linear * distance) + \
+                               (light.quadratic * distance * distance));
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+
+    return (ambient + (1.0f - shadow) * (diffuse + specular));
+}
+
+vec3 calc_spotlight(Spotlight light, vec3 normal, vec3 frag_pos, vec3 view_dir)
+{
+    // Ambient.
+    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, tex_coords));
+
+    // Diffuse.
+    vec3 light_dir = normalize(light.position - frag_pos);
+    float diff = max(dot(normal, light_dir), 0.0f);
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, tex_coords));
+
+    // Specular.
+    vec3 specular = vec3(0.0f);
+    if (ENABLE_SPECULAR != 0)
+    {
+        vec3 reflect_dir = reflect(-light_dir, normal);
+        float spec = pow(max(dot(view_dir, reflect_dir), 0.0f), material.shininess);
+        specular = light.specular * spec * vec3(texture(material.texture_specular1, tex_coords));
+    }
+
+    // Attenuation.
+    float distance = length(light.position - frag_pos);
+    float attenuation = 1.0f / (light.constant + \
+                               (light.linear * distance) + \
+                               (light.quadratic * distance * distance));
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+
+    // Compute spotlight cone.
+    float theta = dot(light_dir, normalize(-light.direction));
+    float epsilon = light.inner_cutoff - light.outer_cutoff;
+    float intensity = clamp((theta - light.outer_cutoff) / epsilon, 0.0f, 1.0f);
+
+    diffuse *= intensity;
+    specular *= intensity;
+
+    return (ambient + diffuse + specular);
+}
+
+// Sum of every enabled light. `shadow` only darkens the point lights' direct
+// terms, and is computed once per fragment by the caller.
+vec3 calc_lighting(vec3 normal, vec3 frag_pos, vec3 view_dir, float shadow)
+{
+    vec3 result = vec3(0.0f);
+
+    // Directional light.
+    if (ENABLE_DIRECTIONAL_LIGHT != 0)
+        result += calc_dir_light(dir_light, normal, view_dir);
+
+    // Point lights.
+    for (int i = 0; i < NUM_POINT_LIGHTS; i++)
+        result += calc_point_light(point_lights[i], normal, frag_pos, view_dir, shadow);
+
+    // Spotlight.
+    if (ENABLE_SPOTLIGHT != 0)
+        result += calc_spotlight(spotlight, normal, frag_pos, view_dir);
+
+    return result;
+}
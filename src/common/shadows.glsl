@@ -0,0 +1,51 @@
+// Shadow map lookup shared by the shadowed targets.
+
+#include "features.glsl"
+
+uniform sampler2D shadow_map;
+
+float calc_shadow(vec4 frag_pos_light_space)
+{
+    // Normalize perspective.
+    vec3 proj_coords = frag_pos_light_space.xyz / frag_pos_light_space.w;
+
+    // Transform from clip space ([-1, 1]) to screen space ([0, 1]).
+    proj_coords = (proj_coords * 0.5f) + 0.5f;
+
+    // Compute closest and current depths.
+    float closest_depth = texture(shadow_map, proj_coords.xy).r;
+    float current_depth = proj_coords.z;
+
+    // Provide bias to shadow calculations to remove shadow acne.
+    float shadow_bias = 0.0005f;
+
+    // Calculate whether fragment is in shadow. Implement PCF by averaging
+    // surrounding texels.
+    float shadow = 0.0f;
+    if (SHADOW_PCF_RADIUS > 0)
+    {
+        vec2 texel_size = 1.0f / textureSize(shadow_map, 0);
+        for (int x = -SHADOW_PCF_RADIUS; x <= SHADOW_PCF_RADIUS; ++x)
+        {
+            for (int y = -SHADOW_PCF_RADIUS; y <= SHADOW_PCF_RADIUS; ++y)
+            {
+                float pcf_depth = texture(shadow_map, proj_coords.xy + vec2(x, y) * texel_size).r;
+                shadow += current_depth - shadow_bias > pcf_depth ? 1.0f : 0.0f;
+            }
+        }
+
+        // Average the taps, so shadow strength does not depend on the radius.
+        float pcf_width = float(2 * SHADOW_PCF_RADIUS + 1);
+        shadow /= pcf_width * pcf_width;
+    }
+    else
+    {
+        shadow = current_depth - shadow_bias > closest_depth ? 1.0f : 0.0f;
+    }
+
+    // Remove shadows outside of light frustum.
+    if (proj_coords.z > 1.0f)
+        shadow = 0.0f;
+
+    return shadow;
+}
@@ -0,0 +1,92 @@
+/*
+ * Resolve #include directives in a GLSL source the same way Shader does at
+ * runtime, so the result can be handed to an offline compiler. Each
+ * --require adds an #extension directive after #version, for features the
+ * offline build needs beyond the source's version.
+ *
+ * Usage: shader_expand <input> <output> [-I <directory>]... [--require <extension>]...
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "shader_preprocessor.hpp"
+
+// Insert `#extension <name> : require` for each extension right after the
+// #version line.
+std::string require_extensions(const std::string& source,
+    const std::vector<std::string>& extensions)
+{
+    if (extensions.empty())
+        return source;
+
+    std::string block;
+    for (const auto& extension : extensions)
+        block += "#extension " + extension + " : require\n";
+
+    std::size_t version_pos = source.find("#version");
+    if (version_pos == std::string::npos)
+        return block + source;
+
+    std::size_t line_end = source.find('\n', version_pos);
+    if (line_end == std::string::npos)
+        return source + "\n" + block;
+
+    // Keep line numbers in compiler errors matching the file.
+    std::size_t version_line = std::count(source.begin(), source.begin() + version_pos, '\n') + 1;
+    block += "#line " + std::to_string(version_line + 1) + "\n";
+
+    std::string result = source;
+    result.insert(line_end + 1, block);
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0]
+            << " <input> <output> [-I <directory>]... [--require <extension>]...\n";
+        return 2;
+    }
+
+    std::vector<std::string> extensions;
+    for (int i = 3; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-I" && i + 1 < argc)
+            ShaderPreprocessor::add_include_directory(argv[++i]);
+        else if (arg.rfind("-I", 0) == 0 && arg.size() > 2)
+            ShaderPreprocessor::add_include_directory(arg.substr(2));
+        else if (arg == "--require" && i + 1 < argc)
+            extensions.push_back(argv[++i]);
+        else
+        {
+            std::cerr << "shader_expand: unknown argument " << arg << '\n';
+            return 2;
+        }
+    }
+
+    std::string source;
+    std::vector<std::string> files;
+    if (!ShaderPreprocessor::expand(argv[1], source, files))
+        return 1;
+
+    std::filesystem::path output_path = argv[2];
+    if (output_path.has_parent_path())
+        std::filesystem::create_directories(output_path.parent_path());
+
+    std::ofstream output(output_path, std::ios::binary | std::ios::trunc);
+    if (!output)
+    {
+        std::cerr << "shader_expand: cannot write " << output_path << '\n';
+        return 1;
+    }
+
+    output << require_extensions(source, extensions);
+    return 0;
+}